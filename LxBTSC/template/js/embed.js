@@ -9,8 +9,31 @@ var imageMime = [ "image/gif", "image/jpeg", "image/png", "image/svg+xml", "imag
 var audioMime = [ "audio/mpeg", "audio/wave", "audio/wav", "audio/x-wav", "audio/x-pn-wav", "audio/webm", "audio/ogg", "audio/flac"];
 var videoMime = [ "video/webm", "video/ogg", "application/ogg" ];
 var h264capable = false;
+// set while TeamSpeak is in the background, embeds wait until it is back
+var lowPower = false;
+var deferredEmbeds = [];
+
+function setPowerMode(low) {
+    lowPower = low;
+    document.body.classList.toggle('low-power', low);
+    if (low) {
+        return;
+    }
+    let embeds = deferredEmbeds;
+    deferredEmbeds = [];
+    embeds.forEach(([messageId, message_text]) => {
+        // skip messages trimmed meanwhile
+        if (document.getElementById(messageId)) {
+            embed(messageId, message_text);
+        }
+    });
+}
 
 function embed(messageId, message_text) {
+    if (lowPower) {
+        deferredEmbeds.push([messageId, message_text]);
+        return;
+    }
     $('a', message_text).each(function(index, element) {
         if (element.protocol.toLocaleLowerCase().startsWith("http")) {
             fetchEmbedHead(element.href)
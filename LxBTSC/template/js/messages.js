@@ -7,27 +7,167 @@
 'use strict'
 let msgid = 0;
 
+// events of one batch are collected per tab and inserted with one append each,
+// work that needs the inserted elements runs after that
+let batchAppends = null;
+let batchCallbacks = [];
+
+// html of events rendered for somewhere else than the end of their tab is collected here
+let renderSink = null;
+let statusSummaries = new Map();
+// seq of the event being handled, the plugin numbers the events of each tab
+let messageSeq;
+
+// decoders for the positional wire format, generated from the schema the plugin publishes,
+// tag 0 is an object sent as is and tag n is schema.types[n - 1], records are objects inside events
+let wireDecoders = [];
+let wireRecords = new Map();
+
+function loadWireSchema(schema) {
+    wireRecords = new Map(schema.records.map(record => [record.record, wireDecoder(null, record.fields)]));
+    wireDecoders = schema.types.map(type => wireDecoder(type.type, type.fields));
+}
+
+// "name", "name:record" or "name:record[]", the record "event" is an event with its own tag
+function wireField(spec) {
+    let [name, kind] = spec.split(':');
+    if (kind === undefined) {
+        return [name, null];
+    }
+    let list = kind.endsWith('[]');
+    let record = list ? kind.slice(0, -2) : kind;
+    let decode = record === 'event' ? wireEvent : m => wireRecords.get(record)(m);
+    return [name, list ? m => m.map(decode) : decode];
+}
+
+// events start with their tag, records don't, nulls are fields the plugin didn't set
+function wireDecoder(type, fields) {
+    let decoders = fields.map(wireField);
+    let first = type !== null ? 1 : 0;
+    return m => {
+        let json = type !== null ? { type: type } : {};
+        decoders.forEach(([name, decode], i) => {
+            let value = m[i + first];
+            if (value !== null) {
+                json[name] = decode ? decode(value) : value;
+            }
+        });
+        return json;
+    };
+}
+
+function wireEvent(m) {
+    return m[0] === 0 ? m[1] : wireDecoders[m[0] - 1](m);
+}
+
+// the plugin is told how long the batch took here, split into building and inserting
+function messagePacked(batch, packed) {
+    let start = performance.now();
+    let [handled, inserted] = messageBatch(JSON.parse(packed).map(wireEvent));
+    qtObject.batchRendered(batch, handled - start, inserted - handled);
+}
+
+function messageBatch(messages) {
+    batchAppends = new Map();
+    for (let json of messages) {
+        try {
+            messageSeq = json.seq;
+            messageSwitch(json);
+        }
+        catch (e) {
+            console.log(e);
+        }
+    }
+    messageSeq = undefined;
+    let handled = performance.now();
+    let appends = batchAppends;
+    batchAppends = null;
+    for (let [element, pending] of appends) {
+        let first = element.childElementCount;
+        element.insertAdjacentHTML('beforeend', pending.html.join(''));
+        markSeqs(element, first, pending.seqs);
+    }
+    let callbacks = batchCallbacks;
+    batchCallbacks = [];
+    callbacks.forEach(callback => callback());
+
+    if (isBottom) {
+        window.scroll(0, document.body.scrollHeight);
+    }
+    return [handled, performance.now()];
+}
+
+function appendToTab(tab, html, callback) {
+    if (renderSink !== null) {
+        renderSink.html.push(html);
+        renderSink.seqs.push(messageSeq);
+        if (callback) {
+            renderSink.callbacks.push(callback);
+        }
+        return;
+    }
+    if (batchAppends === null) {
+        let first = tab[0].childElementCount;
+        tab.append(html);
+        markSeqs(tab[0], first, [messageSeq]);
+        if (callback) {
+            callback();
+        }
+        return;
+    }
+    let pending = batchAppends.get(tab[0]);
+    if (!pending) {
+        pending = { html: [], seqs: [] };
+        batchAppends.set(tab[0], pending);
+    }
+    pending.html.push(html);
+    pending.seqs.push(messageSeq);
+    if (callback) {
+        batchCallbacks.push(callback);
+    }
+}
+
+// every event is one element, embeds are added after it later
+function markSeqs(element, first, seqs) {
+    for (let i = 0; i < seqs.length && first + i < element.childElementCount; ++i) {
+        if (seqs[i] !== undefined && seqs[i] !== null) {
+            element.children[first + i].dataset.seq = seqs[i];
+        }
+    }
+}
+
+// events handled without touching a tab, returns their html, seqs and what to run once inserted
+function renderDetached(events) {
+    renderSink = { html: [], seqs: [], callbacks: [] };
+    for (let json of events) {
+        try {
+            messageSeq = json.seq;
+            messageSwitch(json);
+        }
+        catch (e) {
+            console.log(e);
+        }
+    }
+    messageSeq = undefined;
+    let rendered = renderSink;
+    renderSink = null;
+    return rendered;
+}
+
 function messageSwitch(json) {
     const messages = {
         "textMessage": () => addTextMessage(json.target, json.direction, json.time, json.name, json.userlink, json.line, json.mode, json.client, json.receiver),
         "pokeMessage": () =>ts3ClientPoked(json.target, json.time, json.link, json.name, json.message),
         "welcomeMessage": () =>ts3ServerWelcome(json.target, json.time, json.message),
-        "serverConnected": () =>ts3ServerConnected(json.target, json.time, json.message),
-        "serverDisconnected": () =>ts3ServerDisconnected(json.target, json.time),
-        "serverStopped": () =>ts3ServerStopped(json.target, json.time, json.message),
-        "clientConnected": () =>ts3ClientConnected(json.target, json.time, json.link, json.name),
-        "clientDisconnected": () =>ts3ClientDisconnected(json.target, json.time, json.link, json.name, json.message),
-        "clientTimeout": () =>ts3ClientTimeout(json.target, json.time, json.link, json.name),
-        "channelKick": () =>ts3ClientKickedFromChannel(json.target, json.time, json.link, json.name, json.kickerlink, json.kickername, json.message),
-        "serverKick": () =>ts3ClientKickedFromServer(json.target, json.time, json.link, json.name, json.kickerlink, json.kickername, json.message),
-        "clientBan": () =>ts3ClientBannedFromServer(json.target, json.time, json.link, json.name, json.kickerlink, json.kickername, json.message),
-        "clientMoveBySelf": () =>ts3ClientMovedBySelf(json.target, json.time, json.clientLink, json.clientName, json.oldChannelLink, json.newChannelLink, json.oldChannelName, json.newChannelName),
-        "clientMoveByOther": () =>ts3ClientMovedByOther(json.target, json.time, json.clientLink, json.clientName, json.moverLink, json.moverName, json.oldChannelLink, json.newChannelLink, json.oldChannelName, json.newChannelName, json.moveMessage),
-        "channelCreated": () =>ts3ChannelCreated(json.target, json.time, json.channelLink, json.channelName, json.creatorLink, json.creatorName),
-        "channelDeleted": () =>ts3ChannelDeleted(json.target, json.time, json.channelLink, json.channelName, json.deleterLink, json.deleterName),
         "consoleMessage": () =>addConsoleMessage(json.target, json.mode, json.client, json.message),
+        "consoleMessageToCurrentTab": () =>addConsoleMessageToCurrentTab(json.message),
         "chatLog": () =>ts3LogRead(json.target, json.log),
-        "privateChatLog": () =>ts3PrivateLogRead(json.target, json.client, json.log)
+        "privateChatLog": () =>ts3PrivateLogRead(json.target, json.client, json.log),
+        "historyPage": () =>ts3HistoryPage(json.target, json.mode, json.client, json.log),
+        "searchResults": () =>ts3SearchResults(json.query, json.results, json.complete),
+        "statusSummary": () =>ts3StatusSummary(json.target, json.time, json.kind, json.events),
+        "tabRange": () =>ts3TabRange(json.target, json.mode, json.client, json.before, json.events),
+        "status": () =>ts3Status(json.target, json.time, json.style, json.text)
     };
     messages[json.type]();
 }
@@ -144,26 +284,16 @@ function addTextMessage(target, direction, time, name, userlink, line, mode, cli
     
     let tab = getTab(target, mode, direction === "Outgoing" ? receiver : client);
 
-    Config.AVATARS_ENABLED ? 
-        tab.append(avatarStyle_normalTextTemplate(msgid, direction, time, userlink, name, parsed.get(0).outerHTML, target, client)) :
-        tab.append(normalTextTemplate(msgid, direction, time, userlink, name, parsed.get(0).outerHTML));
-    
-    if (Config.EMBED_ENABLED) {
-        embed(msgid, parsed);
-    }
-
-    if (isBottom) {
-        window.scroll(0, document.body.scrollHeight);
-    }
+    let id = msgid;
+    appendToTab(tab, Config.AVATARS_ENABLED ? 
+        avatarStyle_normalTextTemplate(msgid, direction, time, userlink, name, parsed.get(0).outerHTML, target, client) :
+        normalTextTemplate(msgid, direction, time, userlink, name, parsed.get(0).outerHTML),
+        Config.EMBED_ENABLED ? () => embed(id, parsed) : null);
 }
 
 function addStatusMessage(target, line) {
     let tab = getTab(target, 3, "");
-    tab.append(line);
-
-    if (isBottom) {
-        window.scroll(0, document.body.scrollHeight);
-    }
+    appendToTab(tab, line);
 }
 
 function ts3ClientPoked(target, time, link, name, message) {
@@ -171,139 +301,95 @@ function ts3ClientPoked(target, time, link, name, message) {
 
     var parsed = parseBBCode(message);
     let tab = getTab(target, 3, "");
-    tab.append(pokeTextTemplate(msgid, time, link, name, parsed));
-
-    if (isBottom) {
-        window.scroll(0, document.body.scrollHeight);
-    }
+    appendToTab(tab, pokeTextTemplate(msgid, time, link, name, parsed));
 }
 
 function addConsoleMessage(target, mode, client, message) {
     ++msgid;
 
     let tab = getTab(target, mode, client);
-    tab.append('<p class="TextMessage_Console">'+parseBBCode(message)+'</p>');
-    
-    if (isBottom) {
-        window.scroll(0, document.body.scrollHeight);
-    }
-}
-
-function ts3ServerWelcome(target, time, message) {
-    ++msgid;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_Welcome", time, parseBBCode(message)));
+    appendToTab(tab, '<p class="TextMessage_Console">'+parseBBCode(message)+'</p>');
 }
 
-function ts3ServerConnected(target, time, servername) {
-    var text;
-    if (servername.length > 0) {
-        text = 'Connected to Server: <b><a href="channelid://0" class="TextMessage_ServerLink" oncontextmenu="ts3LinkClicked(event)">'+servername+'</a></b>';
+// for when the plugin doesn't know which tab is shown, nothing to do before a tab was ever shown
+function addConsoleMessageToCurrentTab(message) {
+    if (currentTab) {
+        addConsoleMessage(currentTab.target, currentTab.mode, currentTab.client, message);
     }
-    else {
-        text = "Connected";
-    }
-    ++msgid;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_Connected", time, text));
 }
 
-function ts3ServerDisconnected(target, time) {
-    ++msgid;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_Disconnected", time, "Disconnected"));
-}
-
-function ts3ServerStopped(target, time, message) {
-    ++msgid;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ServerError", time, "Server Shutdown: "+message));
-}
-
-function ts3ServerConnectionLost(target, time) {
-    ++msgid;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_Disconnected", time, "Connection to server lost"));
-}
-
-function ts3ClientConnected(target, time, link, name) {
-    ++msgid;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ClientConnected", time, '<a href="'+link+'" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"'+name+'"</a> connected'));
-}
-
-function ts3ClientDisconnected(target, time, link, name, message) {
-    ++msgid;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ClientDisconnected", time, '<a href="'+link+'" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"'+name+'"</a> disconnected ('+message+')'));
-}
-
-function ts3ClientTimeout(target, time, link, name) {
-    ++msgid;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ClientDropped", time, '<a href="'+link+'" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"'+name+'"</a> timed out'));
-}
-
-function ts3ClientKickedFromChannel(target, time, link, name, kickerlink, kickername, message) {
-    ++msgid;
-    let text;
-    if (link)
-        text = `<a href="${link}" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"${name}"</a> was kicked from a channel by <a href="${kickerlink}" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"${kickername}"</a> (${message})`;
-    else
-        text = `You were kicked from the channel by <a href="${kickerlink}" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"${kickername}"</a> (${message})`;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ClientKicked", time, text));
-}
-
-function ts3ClientKickedFromServer(target, time, link, name, kickerlink, kickername, message) {
+function ts3ServerWelcome(target, time, message) {
     ++msgid;
-    let text;
-    if (link)
-        text = `<a href="${link}" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"${name}"</a> was kicked from the server by <a href="${kickerlink}" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"${kickername}"</a> (${message})`;
-    else
-        text = `You were kicked from the server by <a href="${kickerlink}" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"${kickername}"</a> (${message})`;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ClientKicked", time, text));
+    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_Welcome", time, parseBBCode(message)));
 }
 
-function ts3ClientBannedFromServer(target, time, link, name, kickerlink, kickername, message) {
+// the text is rendered and escaped by the plugin
+function ts3Status(target, time, style, text) {
     ++msgid;
-    let text;
-    if (link)
-        text = `<a href="${link}" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"${name}"</a> was banned from the server by <a href="${kickerlink}" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"${kickername}"</a> (${message})`;
-    else
-        text = `You were banned from the server by <a href="${kickerlink}" class="TextMessage_UserLink" oncontextmenu="ts3LinkClicked(event)">"${kickername}"</a> (${message})`;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ClientBanned", time, text));
+    addStatusMessage(target, statusTextTemplate(msgid, style, time, text));
 }
 
-function ts3ClientMovedBySelf(target, time, clientLink, clientName, oldChannelLink, newChannelLink, oldChannelName, newChannelName) {
-    ++msgid;
-    let text;
-    if (clientLink)
-        text = `<a href="${clientLink}">"${clientName}"</a> switched from channel <a href="${oldChannelLink}">"${oldChannelName}"</a> to <a href="${newChannelLink}">"${newChannelName}"</a>`;
-    else
-        text = `You switched from channel <a href="${oldChannelLink}">"${oldChannelName}"</a> to <a href="${newChannelLink}">"${newChannelName}"</a>`;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ClientMoved", time, text));
-}
+const statusSummaryText = {
+    "clientConnected": ["TextMessage_ClientConnected", "clients connected"],
+    "clientDisconnected": ["TextMessage_ClientDisconnected", "clients disconnected"],
+    "clientMoveBySelf": ["TextMessage_ClientMoved", "clients switched channels"]
+};
 
-function ts3ClientMovedByOther(target, time, clientLink, clientName, moverLink, moverName, oldChannelLink, newChannelLink, oldChannelName, newChannelName, moveMessage) {
+// a burst of status events as one line, the events themselves are shown on click
+function ts3StatusSummary(target, time, kind, events) {
     ++msgid;
-    let text;
-    if (clientLink)
-        text = `<a href="${clientLink}">"${clientName}"</a> was moved from channel <a href="${oldChannelLink}">"${oldChannelName}"</a> to <a href="${newChannelLink}">"${newChannelName}"</a> by <a href="${moverLink}">"${moverName}"</a>${moveMessage.length > 0 ? `(${moveMessage})` : ""}`;
-    else
-        text = `You were moved from channel <a href="${oldChannelLink}">"${oldChannelName}"</a> to <a href="${newChannelLink}">"${newChannelName}"</a> by <a href="${moverLink}">"${moverName}"</a>${moveMessage.length > 0 ? `(${moveMessage})` : ""}`;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ClientMoved", time, text));
+    let [type, text] = statusSummaryText[kind] || ["InfoMessage", "events"];
+    statusSummaries.set(String(msgid), events);
+    // forget summaries that were trimmed from their tab
+    if (statusSummaries.size > 100) {
+        for (let id of statusSummaries.keys()) {
+            if (!document.getElementById(id) && id !== String(msgid)) {
+                statusSummaries.delete(id);
+            }
+        }
+    }
+    addStatusMessage(target, statusTextTemplate(msgid, type, time,
+        `${events.length} ${text} <span class="status-summary-expand" data-summary="${msgid}">(show)</span>`));
 }
 
-function ts3ChannelCreated(target, time, channelLink, channelName, creatorLink, creatorName) {
-    ++msgid;
-    let text;
-    if (creatorLink)
-        text = `Channel <a href="${channelLink}">"${channelName}"</a> created successfully by <a href="${creatorLink}">"${creatorName}"</a>`;
-    else
-        text = `Channel <a href="${channelLink}">"${channelName}"</a> created successfully`;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ChannelCreated", time, text));
+// the lines stay one element so the summary keeps its place in the tab
+function expandStatusSummary(id) {
+    let events = statusSummaries.get(id);
+    let summary = document.getElementById(id);
+    if (!events || !summary) {
+        return;
+    }
+    statusSummaries.delete(id);
+    let rendered = renderDetached(events);
+    let expanded = document.createElement('div');
+    expanded.innerHTML = rendered.html.join('');
+    if (summary.dataset.seq !== undefined) {
+        expanded.dataset.seq = summary.dataset.seq;
+    }
+    summary.replaceWith(expanded);
 }
 
-function ts3ChannelDeleted(target, time, channelLink, channelName, deleterLink, deleterName) {
-    ++msgid;
-    let text;
-    if (deleterLink)
-        text = `Channel <a href="${channelLink}">"${channelName}"</a> was deleted by <a href="${deleterLink}">"${deleterName}"</a>`;
-    else
-        text = `Channel <a href="${channelLink}">"${channelName}"</a> was deleted`;
-    addStatusMessage(target, statusTextTemplate(msgid, "TextMessage_ChannelCreated", time, text));
+// events the page dropped earlier, put back above the oldest one still shown
+function ts3TabRange(target, mode, client, before, events) {
+    let tab = getTab(target, mode, client);
+    tab.data('loading', false);
+    if (events.length === 0) {
+        // the plugin has nothing older, continue with the logs
+        tab.data('rangeStart', before);
+        requestOlderHistory();
+        return;
+    }
+    let next = tab.children('[data-seq]').first();
+    if (next.length === 0 || Number(next[0].dataset.seq) !== before) {
+        return;
+    }
+    let rendered = renderDetached(events);
+    let height = document.body.scrollHeight;
+    let first = next.index();
+    next[0].insertAdjacentHTML('beforebegin', rendered.html.join(''));
+    markSeqs(tab[0], first, rendered.seqs);
+    rendered.callbacks.forEach(callback => callback());
+    window.scroll(0, window.pageYOffset + document.body.scrollHeight - height);
 }
 
 function ts3LogRead(target, log) {
@@ -324,16 +410,93 @@ function ts3PrivateLogRead(target, client, log) {
     }
 }
 
+// the plugin only sends as many messages as "Max lines of history" allows
 function appendLog(target, tab, log) {
-    let i = Math.max(log.length - Config.MAX_HISTORY, 0);
+    let html = logHtml(target, log);
+    html += '<div class="history-divider"><span>End History</span></div>';
+    tab[0].insertAdjacentHTML('afterbegin', html);
+    markOffsets(tab, log);
+    tab.data('more', log.length > 0);
+}
+
+// older page requested by scrolling to the top of a tab
+function ts3HistoryPage(target, mode, client, log) {
+    let tab = getTab(target, mode, client);
+    tab.data('loading', false);
+    let jump = tab.data('jump');
+    if (jump !== undefined) {
+        tab.removeData('jump');
+        jumpLog(target, tab, log, jump);
+        return;
+    }
+    if (log.length === 0) {
+        tab.data('more', false);
+        return;
+    }
+    // keep the view on the message that was at the top
+    let height = document.body.scrollHeight;
+    tab[0].insertAdjacentHTML('afterbegin', logHtml(target, log));
+    markOffsets(tab, log);
+    window.scroll(0, window.pageYOffset + document.body.scrollHeight - height);
+}
+
+// replace the history part of a tab with a page ending at a search result
+function jumpLog(target, tab, log, offset) {
+    tab.children('[data-offset], .history-divider').remove();
+    appendLog(target, tab, log);
+    let hit = tab.children(`[data-offset="${offset}"]`);
+    if (hit.length > 0) {
+        hit.addClass('history-hit');
+        hit[0].scrollIntoView();
+    }
+}
+
+function logHtml(target, log) {
     let html = "";
-    for (; i < log.length; ++i) {
+    for (let i = 0; i < log.length; ++i) {
+        // messages written by the plugin are kept as bbcode, imported ones as the html TeamSpeak logged
+        let text = log[i].line !== undefined ? parseBBCode(log[i].line) : log[i].text;
         html += Config.AVATARS_ENABLED ? 
-            avatarStyle_normalTextTemplate(msgid, "", log[i].time, log[i].link, log[i].name, log[i].text, target, log[i].uid) :
-            normalTextTemplate(msgid, "InfoMessage", log[i].time, log[i].link, log[i].name, log[i].text);
+            avatarStyle_normalTextTemplate(msgid, "", log[i].time, log[i].link, log[i].name, text, target, log[i].uid) :
+            normalTextTemplate(msgid, "InfoMessage", log[i].time, log[i].link, log[i].name, text);
             
         ++msgid;
     }
-    html += '<div class="history-divider"><span>End History</span></div>';
-    tab[0].insertAdjacentHTML('afterbegin', html);
+    return html;
+}
+
+// each history message remembers where it is in the log file, the oldest one is the cursor for the next page
+function markOffsets(tab, log) {
+    tab.children().slice(0, log.length).each(function(i) {
+        this.dataset.offset = log[i].offset;
+    });
+    if (log.length > 0) {
+        tab.data('oldest', log[0].offset);
+    }
+}
+
+function requestOlderHistory() {
+    if (!currentTab) {
+        return;
+    }
+    let tab = getTab(currentTab.target, currentTab.mode, currentTab.client);
+    if (tab.data('loading')) {
+        return;
+    }
+    // events trimmed from the page are still kept by the plugin
+    let first = tab.children('[data-seq]').first();
+    if (first.length > 0) {
+        let seq = Number(first[0].dataset.seq);
+        let start = tab.data('rangeStart');
+        if (start === undefined || seq > start) {
+            tab.data('loading', true);
+            qtObject.requestRange(currentTab.target, currentTab.mode, currentTab.client, seq, Config.MAX_HISTORY);
+            return;
+        }
+    }
+    if (!Config.HISTORY_ENABLED || !tab.data('more') || tab.data('oldest') === undefined) {
+        return;
+    }
+    tab.data('loading', true);
+    qtObject.requestHistory(currentTab.target, currentTab.mode, currentTab.client, tab.data('oldest'), Config.MAX_HISTORY);
 }
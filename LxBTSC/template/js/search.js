@@ -0,0 +1,73 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+'use strict'
+let searchDelay;
+let searchResults = [];
+
+function searchHistory() {
+    clearTimeout(searchDelay);
+    searchDelay = setTimeout(function() {
+        let text = document.getElementById('history-search').value;
+        if (!text.trim()) {
+            document.getElementById('history-results').innerHTML = "";
+            return;
+        }
+        let everywhere = document.getElementById('history-everywhere').checked;
+        let target = everywhere || !currentTab ? "" : currentTab.target;
+        let mode = Number(document.getElementById('history-mode').value);
+        let sender = document.getElementById('history-sender').value.trim();
+        let from = dateToSeconds(document.getElementById('history-from').value, false);
+        let to = dateToSeconds(document.getElementById('history-to').value, true);
+        qtObject.searchHistory(text, target, mode, sender, from, to, 100);
+    }, 250);
+}
+
+// date inputs are yyyy-mm-dd in local time, the whole day is included
+function dateToSeconds(value, endOfDay) {
+    if (!value) {
+        return 0;
+    }
+    let date = new Date(value + (endOfDay ? 'T23:59:59' : 'T00:00:00'));
+    return isNaN(date) ? 0 : Math.floor(date.getTime() / 1000);
+}
+
+function ts3SearchResults(query, results, complete) {
+    if (query !== document.getElementById('history-search').value) {
+        return;
+    }
+    searchResults = results;
+    let html = "";
+    results.forEach((result, i) => {
+        html += `
+            <div class='history-result' data-index='${i}'>
+            <span class='TextMessage_Time'><${result.time}> </span>
+            <span class='TextMessage_UserLink'>"${result.name}"</span>:
+            <span class='TextMessage_Text'>${result.text}</span>
+            </div>
+        `;
+    });
+    if (!complete) {
+        html += "<div class='history-result-info'>Still indexing, results may be missing</div>";
+    }
+    else if (results.length === 0) {
+        html += "<div class='history-result-info'>No results</div>";
+    }
+    document.getElementById('history-results').innerHTML = html;
+}
+
+// load the page of history ending with the result into its tab
+function jumpToHistory(index) {
+    let result = searchResults[index];
+    if (!result) {
+        return;
+    }
+    showTab(result.target, result.mode, result.client);
+    let tab = getTab(result.target, result.mode, result.client);
+    tab.data('jump', result.offset);
+    tab.data('loading', true);
+    qtObject.requestHistory(result.target, result.mode, result.client, result.before, Config.MAX_HISTORY);
+}
@@ -6,17 +6,36 @@
 */
 'use strict'
 let serverMap = new Map();
+let currentTab;
 let messageLimitObserver = new MutationObserver((mutations) => {
     mutations.forEach((mutation) => {
-        if (mutation.addedNodes.length > 0) {
-            let over = mutation.target.childElementCount - Config.MAX_LINES;
-            if(over > 0) {
-                $(mutation.target).children().slice(0, over).remove();
-            }
+        // leave older pages alone while they are being read
+        if (mutation.addedNodes.length > 0 && isBottom) {
+            trimTab($(mutation.target));
         }
     });
 });
 
+// only about a screen is kept rendered, the plugin has the rest and sends it again when scrolled to
+function trimTab(tab) {
+    let over = tab[0].childElementCount - qtObject.renderWindow;
+    if (over <= 0) {
+        return;
+    }
+    let removed = tab.children().slice(0, over);
+    let newest = removed.filter('[data-offset]').last();
+    removed.remove();
+    let oldest = tab.children('[data-offset]').first();
+    if (oldest.length > 0) {
+        tab.data('oldest', Number(oldest[0].dataset.offset));
+    }
+    else if (newest.length > 0) {
+        // all of the history is gone, read it again from the newest removed message
+        tab.data('oldest', Number(newest[0].dataset.offset) + 1);
+        tab.data('more', true);
+    }
+}
+
 function addServerTabs(serverId, dontshow) {
     if (!serverMap.has(serverId)) {
         let tabs = new Map();
@@ -61,8 +80,11 @@ function showTab(target, mode, client) {
         }
     }
     let tab = getTab(target, mode, client);
+    currentTab = { target: target, mode: mode, client: client };
     tab.show();
     window.scroll(0, document.body.scrollHeight);
+    // the plugin holds back messages of hidden tabs
+    qtObject.tabShown(target, mode, client);
 }
 
 function createTab() {
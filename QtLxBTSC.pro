@@ -19,22 +19,44 @@ HEADERS += QtLxBTSC/ChatWidget.h \
            QtLxBTSC/FileTransferListWidget.h \
            QtLxBTSC/FullScreenWindow.h \
            QtLxBTSC/globals.h \
+           QtLxBTSC/HistoryLoader.h \
+           QtLxBTSC/LatencyStats.h \
+           QtLxBTSC/LogIndex.h \
+           QtLxBTSC/LogReader.h \
+           QtLxBTSC/LogScanner.h \
+           QtLxBTSC/MessageStore.h \
            QtLxBTSC/plugin.h \
            QtLxBTSC/PluginHelper.h \
+           QtLxBTSC/ReplayBuffer.h \
+           QtLxBTSC/SearchIndex.h \
+           QtLxBTSC/StatusText.h \
            QtLxBTSC/TsClient.h \
            QtLxBTSC/TsServer.h \
            QtLxBTSC/TsWebEnginePage.h \
            QtLxBTSC/TsWebObject.h \
-           QtLxBTSC/utils.h
+           QtLxBTSC/UidPool.h \
+           QtLxBTSC/utils.h \
+           QtLxBTSC/WireFormat.h
 SOURCES += QtLxBTSC/ChatWidget.cpp \
            QtLxBTSC/ConfigWidget.cpp \
            QtLxBTSC/FileTransferItemWidget.cpp \
            QtLxBTSC/FileTransferListWidget.cpp \
            QtLxBTSC/FullScreenWindow.cpp \
            QtLxBTSC/globals.cpp \
+           QtLxBTSC/HistoryLoader.cpp \
+           QtLxBTSC/LatencyStats.cpp \
+           QtLxBTSC/LogIndex.cpp \
+           QtLxBTSC/LogReader.cpp \
+           QtLxBTSC/LogScanner.cpp \
+           QtLxBTSC/MessageStore.cpp \
            QtLxBTSC/plugin.cpp \
            QtLxBTSC/PluginHelper.cpp \
+           QtLxBTSC/ReplayBuffer.cpp \
+           QtLxBTSC/SearchIndex.cpp \
+           QtLxBTSC/StatusText.cpp \
            QtLxBTSC/TsClient.cpp \
            QtLxBTSC/TsServer.cpp \
            QtLxBTSC/TsWebObject.cpp \
-           QtLxBTSC/utils.cpp
+           QtLxBTSC/UidPool.cpp \
+           QtLxBTSC/utils.cpp \
+           QtLxBTSC/WireFormat.cpp
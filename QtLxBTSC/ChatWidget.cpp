@@ -12,7 +12,6 @@
 #include <QClipboard>
 #include <QWebEngineSettings>
 #include <QWebEngineProfile>
-#include <QTimer>
 
 ChatWidget::ChatWidget(const QString& path, TsWebObject* webObject, QWidget *parent)
     : QFrame(parent)
@@ -25,7 +24,6 @@ ChatWidget::ChatWidget(const QString& path, TsWebObject* webObject, QWidget *par
 	, copyUrlAction(new QAction("Copy Link", this))
 	, page(new TsWebEnginePage(view))
 	, channel(new QWebChannel(page))
-	, loadComplete(false)
 {
 	this->setObjectName(QStringLiteral("ChatWidget"));
 		
@@ -41,52 +39,21 @@ ChatWidget::ChatWidget(const QString& path, TsWebObject* webObject, QWidget *par
 	connect(copyAction, &QAction::triggered, this, &ChatWidget::onCopyActivated);
 	connect(copyUrlAction, &QAction::triggered, this, &ChatWidget::onCopyUrlActivated);
 	connect(view, &QWebEngineView::customContextMenuRequested, this, &ChatWidget::onShowContextMenu);
+	// events are queued in the web object until the page itself reports ready
+	connect(view, &QWebEngineView::loadStarted, wObject, &TsWebObject::pageUnloaded);
 	connect(view, &QWebEngineView::loadFinished, this, [=](bool ok)
 	{
-		if (!ok)
-		{
-			// don't trigger anything when loadFinished is triggered but load is not ok
-			return;
-		}
-		if (!loadComplete)
-		{
-			loadComplete = true;
-			logInfo("Page load finished");
-		}
-		else
-		{
-			emit pageReloaded();
-			logInfo("Page reload finished");
-		}
+		logInfo(ok ? "Page load finished" : "Page load failed");
 	});
 
 	setupPage();
 	view->setPage(page);
-	waitloop();
 }
 
 ChatWidget::~ChatWidget()
 {
 }
 
-void ChatWidget::waitloop() const
-{
-	if(!loadComplete)
-	{
-		QTimer timer;
-		timer.setSingleShot(true);
-		QEventLoop wait;
-		connect(&timer, &QTimer::timeout, &wait, &QEventLoop::quit);
-		logInfo("Waiting for page load...");
-		timer.start(200);
-		wait.exec();
-		if (!loadComplete)
-		{
-			waitloop();
-		}
-	}
-}
-
 void ChatWidget::setupPage() const
 {
 	page->settings()->setAttribute(QWebEngineSettings::LocalContentCanAccessRemoteUrls, true);
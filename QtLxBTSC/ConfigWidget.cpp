@@ -45,6 +45,12 @@ ConfigWidget::ConfigWidget(const QString& path, QWidget *parent)
 	fontsize->setMinimum(6);
 	fontsize->setMaximum(34);
 	fontsize->setValue(12);
+	batchInterval = new QSpinBox(this);
+	batchInterval->setMinimum(0);
+	batchInterval->setMaximum(1000);
+	batchInterval->setValue(16);
+	batchInterval->setSuffix(" ms");
+	batchInterval->setToolTip("Events arriving within this time are added to the chat together");
 	downloadDir = new QLineEdit("", this);
 	downloadDir->setDisabled(true);
 	QPushButton* browseButton = new QPushButton("...", this);
@@ -68,6 +74,18 @@ ConfigWidget::ConfigWidget(const QString& path, QWidget *parent)
 	clientDisconnectedEvent = new QCheckBox("Show client disconnect");
 	ownDisconnectedEvent = new QCheckBox("Show own disconnect");
 	ownConnectedEvent = new QCheckBox("Show own connect");
+	groupThreshold = new QSpinBox(this);
+	groupThreshold->setMinimum(0);
+	groupThreshold->setMaximum(100);
+	groupThreshold->setValue(5);
+	groupThreshold->setSpecialValueText("Off");
+	groupThreshold->setToolTip("Connects, disconnects and moves past this many are summed up in one line");
+	groupWindow = new QSpinBox(this);
+	groupWindow->setMinimum(100);
+	groupWindow->setMaximum(60000);
+	groupWindow->setSingleStep(500);
+	groupWindow->setValue(2000);
+	groupWindow->setSuffix(" ms");
 
 	eventLayout->addRow(kickEvent);
 	eventLayout->addRow(banEvent);
@@ -79,6 +97,8 @@ ConfigWidget::ConfigWidget(const QString& path, QWidget *parent)
 	eventLayout->addRow(clientDisconnectedEvent);
 	eventLayout->addRow(ownConnectedEvent);
 	eventLayout->addRow(ownDisconnectedEvent);
+	eventLayout->addRow(new QLabel("Group events after:", this), groupThreshold);
+	eventLayout->addRow(new QLabel("Group events within:", this), groupWindow);
 
 	saveButton = new QPushButton("Save", this);
 	connect(saveButton, &QPushButton::clicked, this, &ConfigWidget::save);
@@ -97,6 +117,7 @@ ConfigWidget::ConfigWidget(const QString& path, QWidget *parent)
 	formLayout->addRow(new QLabel("Max lines in tab:", this), maxlines);
 	formLayout->addRow(new QLabel("Max lines of history:", this), maxHistory);
 	formLayout->addRow(new QLabel("Font size:", this), fontsize);
+	formLayout->addRow(new QLabel("Message batching:", this), batchInterval);
 	formLayout->addRow(new QLabel("Download directory:"));
 	formLayout->addRow(downloadDir);
 	formLayout->addRow(browseButton);
@@ -137,6 +158,7 @@ void ConfigWidget::readConfig()
 		maxlines->setValue(jsonObj.value("MAX_LINES").toInt(500));
 		maxHistory->setValue(jsonObj.value("MAX_HISTORY").toInt(50));
 		fontsize->setValue(jsonObj.value("FONT_SIZE").toInt());
+		batchInterval->setValue(jsonObj.value("BATCH_INTERVAL").toInt(16));
 		downloadDir->setText(jsonObj.value("DOWNLOAD_DIR").toString());
 
 		kickEvent->setChecked(jsonObj.value("EVENT_KICK").toBool(true));
@@ -149,6 +171,8 @@ void ConfigWidget::readConfig()
 		clientDisconnectedEvent->setChecked(jsonObj.value("EVENT_CLIENTDISCONNECT").toBool(true));
 		ownConnectedEvent->setChecked(jsonObj.value("EVENT_SELFCONNECT").toBool(true));
 		ownDisconnectedEvent->setChecked(jsonObj.value("EVENT_SELFDISCONNECT").toBool(true));
+		groupThreshold->setValue(jsonObj.value("EVENT_GROUP_THRESHOLD").toInt(5));
+		groupWindow->setValue(jsonObj.value("EVENT_GROUP_WINDOW").toInt(2000));
 
 		QJsonArray remotejson = jsonObj.value("REMOTE_EMOTES").toArray();
 		QStringList list;
@@ -171,6 +195,7 @@ void ConfigWidget::readConfig()
 		maxlines->setValue(500);
 		maxHistory->setValue(50);
 		fontsize->setValue(12);
+		batchInterval->setValue(16);
 		downloadDir->setText("");
 
 		kickEvent->setChecked(true);
@@ -204,6 +229,7 @@ void ConfigWidget::save()
 	jsonObj.insert("MAX_LINES", maxlines->value());
 	jsonObj.insert("MAX_HISTORY", maxHistory->value());
 	jsonObj.insert("FONT_SIZE", fontsize->value());
+	jsonObj.insert("BATCH_INTERVAL", batchInterval->value());
 	jsonObj.insert("DOWNLOAD_DIR", downloadDir->text());
 
 	jsonObj.insert("EVENT_KICK", kickEvent->isChecked());
@@ -216,6 +242,8 @@ void ConfigWidget::save()
 	jsonObj.insert("EVENT_CLIENTDISCONNECT", clientDisconnectedEvent->isChecked());
 	jsonObj.insert("EVENT_SELFCONNECT", ownConnectedEvent->isChecked());
 	jsonObj.insert("EVENT_SELFDISCONNECT", ownDisconnectedEvent->isChecked());
+	jsonObj.insert("EVENT_GROUP_THRESHOLD", groupThreshold->value());
+	jsonObj.insert("EVENT_GROUP_WINDOW", groupWindow->value());
 
 	if (remotes->toPlainText().length() > 1)
 	{
@@ -246,3 +274,8 @@ bool ConfigWidget::getConfigAsBool(const QString& key)
 {
 	return jsonObj.value(key).toBool();
 }
+
+int ConfigWidget::getConfigAsInt(const QString& key, int defaultValue)
+{
+	return jsonObj.value(key).toInt(defaultValue);
+}
@@ -26,6 +26,7 @@ public:
 
 	QString getConfigAsString(const QString& key);
 	bool getConfigAsBool(const QString& key);
+	int getConfigAsInt(const QString& key, int defaultValue = 0);
 
 signals:
 	void configChanged();
@@ -50,6 +51,7 @@ private:
 	QSpinBox* maxlines;
 	QSpinBox* maxHistory;
 	QSpinBox* fontsize;
+	QSpinBox* batchInterval;
 	QPlainTextEdit* remotes;
 	QPushButton* saveButton;
 	QString configPath;
@@ -68,6 +70,8 @@ private:
 	QCheckBox* clientDisconnectedEvent;
 	QCheckBox* ownDisconnectedEvent;
 	QCheckBox* ownConnectedEvent;
+	QSpinBox* groupThreshold;
+	QSpinBox* groupWindow;
 
 	void readConfig();
 };
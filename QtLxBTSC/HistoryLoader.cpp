@@ -0,0 +1,303 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "HistoryLoader.h"
+#include "LogReader.h"
+#include "LogScanner.h"
+#include "globals.h"
+#include <QMutexLocker>
+#include <QFileInfo>
+#include <QTimer>
+
+HistoryLoader::HistoryLoader(QObject *parent)
+	: QObject(parent)
+	, current(0)
+	, searchIndexing(false)
+	, indexTimer(new QTimer(this))
+	, commitTimer(new QTimer(this))
+{
+	indexTimer->setInterval(indexInterval);
+	connect(indexTimer, &QTimer::timeout, this, &HistoryLoader::updateSearchIndex);
+	commitTimer->setSingleShot(true);
+	commitTimer->setInterval(commitDelay);
+	connect(commitTimer, &QTimer::timeout, this, &HistoryLoader::commit);
+}
+
+// deleted on the history thread as it finishes, stores flush what is left
+HistoryLoader::~HistoryLoader()
+{
+	qDeleteAll(stores);
+}
+
+// a request that already ran has nothing left to cancel
+void HistoryLoader::cancel(quint64 requestId)
+{
+	QMutexLocker locker(&cancelMutex);
+	if (requestId >= current)
+	{
+		cancelled.insert(requestId);
+	}
+}
+
+// requests run in the order they were queued, cancels of earlier ones came too late
+bool HistoryLoader::takeCancelled(quint64 requestId)
+{
+	QMutexLocker locker(&cancelMutex);
+	if (requestId > current)
+	{
+		current = requestId;
+		auto it = cancelled.begin();
+		while (it != cancelled.end())
+		{
+			if (*it < current)
+			{
+				it = cancelled.erase(it);
+			}
+			else
+			{
+				++it;
+			}
+		}
+	}
+	return cancelled.remove(requestId);
+}
+
+void HistoryLoader::readLog(quint64 requestId, const QString& target, int count)
+{
+	if (takeCancelled(requestId))
+		return;
+
+	QJsonObject log
+	{
+		{"server", latest(target, "server", count)},
+		{"channel", latest(target, "channel", count)}
+	};
+
+	// cancelled while reading, nobody wants the result anymore
+	if (takeCancelled(requestId))
+		return;
+
+	emit logRead(requestId, target, log);
+}
+
+void HistoryLoader::readPrivateLog(quint64 requestId, const QString& target, const QString& client, const QString& fileName, int count)
+{
+	if (takeCancelled(requestId))
+		return;
+
+	QJsonArray log = latest(target, QString("clients/%1").arg(fileName), count);
+
+	if (takeCancelled(requestId))
+		return;
+
+	emit privateLogRead(requestId, target, client, log);
+}
+
+void HistoryLoader::readPage(quint64 requestId, const QString& target, int mode, const QString& client, const QString& name, qint64 before, int count)
+{
+	if (takeCancelled(requestId))
+		return;
+
+	MessageStore* s = store(target, name);
+	QJsonArray log = s != nullptr ? s->before(before, qBound(0, count, LogReader::maxMessages)) : LogReader::readPage(target, name, before, count);
+
+	if (takeCancelled(requestId))
+		return;
+
+	emit pageRead(requestId, target, mode, client, log);
+}
+
+void HistoryLoader::unwatch(const QString& target, const QString& name)
+{
+	const QString path = MessageStore::storePath(target, name);
+	// every store of a server is under its directory
+	const QString directory = QFileInfo(path).path() + "/";
+	auto it = stores.begin();
+	while (it != stores.end())
+	{
+		if (name.isEmpty() ? it.key().startsWith(directory) : it.key() == path)
+		{
+			delete it.value();
+			it = stores.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+// every open tab has a store, a new one takes in what TeamSpeak logged so far
+// and the plugin stores the messages of the tab from then on
+QJsonArray HistoryLoader::latest(const QString& target, const QString& name, int count)
+{
+	count = qBound(0, count, LogReader::maxMessages);
+	MessageStore* s = store(target, name, true);
+	return s != nullptr ? s->last(count) : QJsonArray();
+}
+
+MessageStore* HistoryLoader::store(const QString& target, const QString& name, bool create)
+{
+	const QString path = MessageStore::storePath(target, name);
+	MessageStore* s = stores.value(path);
+	if (s != nullptr)
+		return s;
+
+	const QString logPath = LogReader::logPath(target, name);
+	const bool exists = QFileInfo::exists(path);
+	if (!exists && !create && !QFileInfo::exists(logPath))
+		return nullptr;
+
+	// earlier history comes from the log TeamSpeak kept so far
+	s = new MessageStore(path, logPath);
+	if (!s->open())
+	{
+		logError(QString("HistoryLoader: could not open %1").arg(path));
+		delete s;
+		return nullptr;
+	}
+	stores.insert(path, s);
+	return s;
+}
+
+MessageStore* HistoryLoader::existingStore(const QString& target, const QString& name)
+{
+	const QString path = MessageStore::storePath(target, name);
+	if (!stores.contains(path) && !QFileInfo::exists(path))
+		return nullptr;
+	return store(target, name);
+}
+
+void HistoryLoader::storeMessage(const QString& target, const QString& name, qint64 timestamp, const QString& uid, int clientId,
+                                 bool outgoing, const QString& fromName, const QString& message)
+{
+	MessageStore* s = store(target, name, true);
+	if (s == nullptr)
+		return;
+
+	// opening the store may have imported this very message from the log
+	if (s->justImported(timestamp, uid.toLatin1()))
+		return;
+
+	s->append({ timestamp, uid.toLatin1(), static_cast<quint16>(clientId), outgoing, false, fromName, message });
+	if (!commitTimer->isActive())
+	{
+		commitTimer->start();
+	}
+}
+
+void HistoryLoader::commit()
+{
+	for (MessageStore* s : stores)
+	{
+		if (s->dirty())
+		{
+			s->flush();
+		}
+	}
+}
+
+void HistoryLoader::updateSearchIndex()
+{
+	// started by the first call, which already runs on the history thread
+	if (!indexTimer->isActive())
+	{
+		indexTimer->start();
+	}
+	if (!searchIndexing && !searchIndex.refresh())
+		return;
+
+	searchIndexing = searchIndex.indexNext();
+	if (searchIndexing)
+	{
+		// let queued history requests in between logs
+		QMetaObject::invokeMethod(this, "updateSearchIndex", Qt::QueuedConnection);
+	}
+}
+
+void HistoryLoader::search(quint64 requestId, const QString& text, const QString& target, int mode, const QString& sender, qint64 from, qint64 to, int limit)
+{
+	if (takeCancelled(requestId))
+		return;
+
+	// logs that changed since the last pass are indexed in the background,
+	// until then the answer comes from what is indexed and is marked incomplete
+	if (!searchIndexing && searchIndex.refresh())
+	{
+		searchIndexing = true;
+		QMetaObject::invokeMethod(this, "updateSearchIndex", Qt::QueuedConnection);
+	}
+
+	SearchIndex::Query query;
+	query.terms = SearchIndex::tokenize(text, false);
+	query.target = target;
+	query.mode = mode;
+	query.uid = sender.toLatin1();
+	query.from = from;
+	query.to = to;
+	query.limit = limit;
+
+	QJsonArray results;
+	for (const SearchIndex::Hit& hit : searchIndex.search(query))
+	{
+		const SearchIndex::Log& log = searchIndex.log(hit.log);
+		QJsonObject message = LogReader::readMessage(log.target, log.name, hit.offset, hit.length);
+		if (message.isEmpty())
+			continue;
+
+		message.insert("target", log.target);
+		message.insert("mode", log.mode);
+		message.insert("client", log.client);
+		// history is read from the store once there is one, so the page cursor and the offset
+		// the page looks for have to be positions in it
+		MessageStore* s = existingStore(log.target, log.name);
+		const qint64 stored = s != nullptr ? s->locate(hit.timestamp, hit.uid) : -1;
+		if (stored >= 0)
+		{
+			message.insert("offset", static_cast<double>(stored));
+			message.insert("before", static_cast<double>(stored + 1));
+		}
+		else if (s != nullptr)
+		{
+			message.insert("before", static_cast<double>(s->offsetAfter(hit.timestamp)));
+		}
+		else
+		{
+			message.insert("before", static_cast<double>(hit.offset + hit.length));
+		}
+		results.append(message);
+	}
+
+	if (takeCancelled(requestId))
+		return;
+
+	emit searchDone(requestId, text, results, searchIndex.isComplete());
+}
+
+void HistoryLoader::benchmark(const QString& target)
+{
+	// same log every time, so results can be compared between machines and builds
+	const QByteArray synthetic = LogScanner::synthesize(benchSize, benchTextPercent);
+	emit benchmarkDone(QString("Benchmark synthetic: %1").arg(LogScanner::benchmark(synthetic.constData(), synthetic.constData() + synthetic.size())));
+
+	for (const QString& name : { QString("server"), QString("channel") })
+	{
+		QFile file(LogReader::logPath(target, name));
+		if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+		{
+			emit benchmarkDone(QString("Benchmark %1: no log").arg(name));
+			continue;
+		}
+		uchar* mapped = file.map(0, file.size());
+		if (mapped == nullptr)
+			continue;
+
+		const char* data = reinterpret_cast<const char*>(mapped);
+		emit benchmarkDone(QString("Benchmark %1: %2").arg(name, LogScanner::benchmark(data, data + file.size())));
+		file.unmap(mapped);
+	}
+}
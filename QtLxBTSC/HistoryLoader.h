@@ -0,0 +1,80 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QObject>
+#include <QJsonObject>
+#include <QJsonArray>
+#include <QMutex>
+#include <QSet>
+#include "SearchIndex.h"
+#include "MessageStore.h"
+
+class QTimer;
+
+// reads chat history on the history thread, requests are queued with invokeMethod
+class HistoryLoader : public QObject
+{
+	Q_OBJECT
+
+public:
+	HistoryLoader(QObject *parent = nullptr);
+	~HistoryLoader();
+
+	// safe to call from any thread
+	void cancel(quint64 requestId);
+
+public slots:
+	// count is the "Max lines of history" setting, nothing past it is parsed
+	void readLog(quint64 requestId, const QString& target, int count);
+	void readPrivateLog(quint64 requestId, const QString& target, const QString& client, const QString& fileName, int count);
+	void readPage(quint64 requestId, const QString& target, int mode, const QString& client, const QString& name, qint64 before, int count);
+	// close the stores of a disconnected server or a closed private chat
+	void unwatch(const QString& target, const QString& name);
+	void storeMessage(const QString& target, const QString& name, qint64 timestamp, const QString& uid, int clientId,
+	                  bool outgoing, const QString& fromName, const QString& message);
+	// builds the search index a log at a time, requeues itself until done and runs again every indexInterval
+	void updateSearchIndex();
+	void search(quint64 requestId, const QString& text, const QString& target, int mode, const QString& sender, qint64 from, qint64 to, int limit);
+	// line scanner against the old regular expression on the server and channel logs
+	void benchmark(const QString& target);
+
+signals:
+	void logRead(quint64 requestId, const QString& target, const QJsonObject& log);
+	void privateLogRead(quint64 requestId, const QString& target, const QString& client, const QJsonArray& log);
+	void pageRead(quint64 requestId, const QString& target, int mode, const QString& client, const QJsonArray& log);
+	void searchDone(quint64 requestId, const QString& text, const QJsonArray& results, bool complete);
+	void benchmarkDone(const QString& result);
+
+private:
+	QMutex cancelMutex;
+	QSet<quint64> cancelled;
+	quint64 current;     // the request running or last run
+	SearchIndex searchIndex;
+	bool searchIndexing;
+	// logs that grew are indexed this often, searches don't wait for it
+	const static int indexInterval = 60 * 1000;
+	QTimer* indexTimer;
+
+	// plugin written stores, flushed together a moment after the first unwritten message
+	const static int commitDelay = 500;
+	QHash<QString, MessageStore*> stores;
+	QTimer* commitTimer;
+
+	// log the benchmark makes up, 8 MiB with mostly text messages like a busy channel
+	const static int benchSize = 8 * 1024 * 1024;
+	const static int benchTextPercent = 80;
+
+	bool takeCancelled(quint64 requestId);
+	// an existing store caught up with its html log, or one created from it if there is one
+	MessageStore* store(const QString& target, const QString& name, bool create = false);
+	// a store that was already created, never imports
+	MessageStore* existingStore(const QString& target, const QString& name);
+	QJsonArray latest(const QString& target, const QString& name, int count);
+	void commit();
+};
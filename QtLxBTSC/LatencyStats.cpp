@@ -0,0 +1,96 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "LatencyStats.h"
+#include <QElapsedTimer>
+#include <cmath>
+
+LatencyStats::LatencyStats()
+{
+	reset();
+}
+
+qint64 LatencyStats::now()
+{
+	static QElapsedTimer clock = []()
+	{
+		QElapsedTimer timer;
+		timer.start();
+		return timer;
+	}();
+	return clock.nsecsElapsed() / 1000;
+}
+
+void LatencyStats::record(Stage stage, qint64 micros)
+{
+	Histogram& histogram = histograms[stage];
+	++histogram.buckets[bucket(micros)];
+	++histogram.count;
+}
+
+void LatencyStats::reset()
+{
+	for (Histogram& histogram : histograms)
+	{
+		histogram.buckets.fill(0, bucketCount);
+		histogram.count = 0;
+	}
+}
+
+QStringList LatencyStats::report() const
+{
+	static const char* names[StageCount] = { "Handler", "Queue", "Bridge", "Page handle", "Page insert", "Total" };
+
+	QStringList lines("Latency: stage, events, p50 / p95 / p99");
+	for (int i = 0; i < StageCount; ++i)
+	{
+		const Histogram& histogram = histograms[i];
+		if (histogram.count == 0)
+		{
+			lines.append(QString("%1: no data").arg(names[i]));
+			continue;
+		}
+		lines.append(QString("%1: %2, %3 / %4 / %5").arg(names[i]).arg(histogram.count)
+			.arg(format(percentile(histogram, 0.50)), format(percentile(histogram, 0.95)), format(percentile(histogram, 0.99))));
+	}
+	return lines;
+}
+
+int LatencyStats::bucket(qint64 micros)
+{
+	if (micros <= 0)
+		return 0;
+	return qMin(bucketCount - 1, static_cast<int>(4 * std::log2(static_cast<double>(micros) + 1)));
+}
+
+// upper end of a bucket, percentiles are reported as that
+qint64 LatencyStats::bucketLimit(int bucket)
+{
+	return static_cast<qint64>(std::exp2((bucket + 1) / 4.0)) - 1;
+}
+
+qint64 LatencyStats::percentile(const Histogram& histogram, double p)
+{
+	const quint64 rank = static_cast<quint64>(std::ceil(p * histogram.count));
+	quint64 seen = 0;
+	for (int i = 0; i < bucketCount; ++i)
+	{
+		seen += histogram.buckets.at(i);
+		if (seen >= rank)
+			return bucketLimit(i);
+	}
+	return bucketLimit(bucketCount - 1);
+}
+
+QString LatencyStats::format(qint64 micros)
+{
+	if (micros < 1000)
+		return QString("%1 us").arg(micros);
+	if (micros < 1000000)
+		return QString("%1 ms").arg(micros / 1000.0, 0, 'f', 1);
+	return QString("%1 s").arg(micros / 1000000.0, 0, 'f', 2);
+}
@@ -0,0 +1,54 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QStringList>
+#include <QVector>
+
+// how long events take from the TeamSpeak callback until they are in the page,
+// kept as log scale histograms per stage so percentiles cost nothing to collect
+class LatencyStats
+{
+public:
+	enum Stage
+	{
+		Handler,    // TeamSpeak callback until the event is queued
+		Queue,      // queued until its batch is sent
+		Bridge,     // web channel both ways, without the time spent in the page
+		Handle,     // page decodes and builds html, emotes, links
+		Insert,     // page inserts into tabs and starts embeds
+		Total,      // TeamSpeak callback, or queueing, until the page acknowledged
+		StageCount
+	};
+
+	LatencyStats();
+
+	// monotonic, microseconds
+	static qint64 now();
+	void record(Stage stage, qint64 micros);
+	void reset();
+	// one line per stage
+	QStringList report() const;
+
+private:
+	// four buckets per doubling, the last one collects everything above
+	const static int bucketCount = 128;
+
+	struct Histogram
+	{
+		QVector<quint64> buckets;
+		quint64 count;
+	};
+
+	Histogram histograms[StageCount];
+
+	static int bucket(qint64 micros);
+	static qint64 bucketLimit(int bucket);
+	static qint64 percentile(const Histogram& histogram, double p);
+	static QString format(qint64 micros);
+};
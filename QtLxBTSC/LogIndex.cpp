@@ -0,0 +1,230 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "LogIndex.h"
+#include "LogScanner.h"
+#include <QDataStream>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDir>
+#include <cstring>
+
+LogIndex::LogIndex(const QString& indexPath)
+	: file(indexPath)
+	, indexedSize(0)
+	, indexedModified(0)
+	, count_(0)
+{
+}
+
+LogIndex::~LogIndex()
+{
+	file.close();
+}
+
+bool LogIndex::open()
+{
+	if (file.isOpen())
+		return true;
+
+	QDir().mkpath(QFileInfo(file.fileName()).absolutePath());
+	if (!file.open(QIODevice::ReadWrite))
+		return false;
+
+	if (file.size() < headerSize)
+	{
+		reset();
+		return true;
+	}
+
+	QDataStream stream(&file);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	quint32 fileMagic, fileVersion, records;
+	stream >> fileMagic >> fileVersion >> indexedSize >> indexedModified >> records;
+	const qint64 expected = headerSize + static_cast<qint64>(records) * recordSize;
+	if (fileMagic != magic || fileVersion != version || file.size() < expected)
+	{
+		reset();
+		return true;
+	}
+	// records written before a crash that never made it into the header are indexed again
+	if (file.size() > expected)
+	{
+		file.resize(expected);
+	}
+	count_ = static_cast<int>(records);
+	return true;
+}
+
+void LogIndex::reset()
+{
+	indexedSize = 0;
+	indexedModified = 0;
+	count_ = 0;
+	file.resize(0);
+	writeHeader();
+}
+
+void LogIndex::writeHeader()
+{
+	file.seek(0);
+	QDataStream stream(&file);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	stream << magic << version << indexedSize << indexedModified << static_cast<quint32>(count_);
+}
+
+bool LogIndex::update(const QString& logPath, const char* data, qint64 size)
+{
+	if (!open())
+		return false;
+
+	const qint64 modified = QFileInfo(logPath).lastModified().toMSecsSinceEpoch();
+
+	// truncated, rotated or rewritten in place
+	Entry lastEntry;
+	if (static_cast<quint64>(size) < indexedSize
+		|| (static_cast<quint64>(size) == indexedSize && modified != indexedModified)
+		|| (count_ > 0 && (!readEntry(count_ - 1, lastEntry) || !matches(lastEntry, data, size))))
+	{
+		reset();
+	}
+
+	if (static_cast<quint64>(size) == indexedSize)
+		return true;
+
+	// only complete lines are indexed, a partially written one is picked up next time
+	const char* begin = data + indexedSize;
+	const char* end = data + size;
+	while (end > begin && end[-1] != '\n')
+	{
+		--end;
+	}
+
+	QByteArray records;
+	QDataStream stream(&records, QIODevice::WriteOnly);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	int added = 0;
+	const char* lineStart = begin;
+	while (lineStart < end)
+	{
+		const char* newline = static_cast<const char*>(memchr(lineStart, '\n', end - lineStart));
+		const char* lineEnd = newline;
+		if (lineEnd > lineStart && lineEnd[-1] == '\r')
+		{
+			--lineEnd;
+		}
+
+		LogLine line;
+		if (LogScanner::scan(lineStart, lineEnd, line))
+		{
+			QByteArray uid = line.uid.left(uidSize);
+			uid.append(QByteArray(uidSize - uid.size(), '\0'));
+			stream << static_cast<quint64>(lineStart - data) << static_cast<quint32>(lineEnd - lineStart) << parseTimestamp(line.time);
+			stream.writeRawData(uid.constData(), uidSize);
+			++added;
+		}
+		lineStart = newline + 1;
+	}
+
+	file.seek(headerSize + static_cast<qint64>(count_) * recordSize);
+	if (file.write(records) != records.size())
+	{
+		// leave the index as it was, records past the header count are ignored
+		file.resize(headerSize + static_cast<qint64>(count_) * recordSize);
+		return false;
+	}
+	count_ += added;
+	indexedSize = end - data;
+	indexedModified = modified;
+	writeHeader();
+	file.flush();
+	return true;
+}
+
+int LogIndex::count() const
+{
+	return count_;
+}
+
+bool LogIndex::readEntry(int i, Entry& entry)
+{
+	QVector<Entry> e = entries(i, i + 1);
+	if (e.isEmpty())
+		return false;
+	entry = e.first();
+	return true;
+}
+
+QVector<LogIndex::Entry> LogIndex::entries(int from, int to)
+{
+	QVector<Entry> result;
+	from = qMax(from, 0);
+	to = qMin(to, count_);
+	if (from >= to || !file.seek(headerSize + static_cast<qint64>(from) * recordSize))
+		return result;
+
+	const QByteArray records = file.read(static_cast<qint64>(to - from) * recordSize);
+	QDataStream stream(records);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	result.reserve(to - from);
+	for (int i = from; i < to && !stream.atEnd(); ++i)
+	{
+		Entry entry;
+		char uid[uidSize];
+		stream >> entry.offset >> entry.length >> entry.timestamp;
+		if (stream.readRawData(uid, uidSize) != uidSize)
+			break;
+		entry.uid = QByteArray(uid, static_cast<int>(qstrnlen(uid, uidSize)));
+		result.append(entry);
+	}
+	return result;
+}
+
+QVector<LogIndex::Entry> LogIndex::last(int n)
+{
+	return entries(count_ - n, count_);
+}
+
+QVector<LogIndex::Entry> LogIndex::before(quint64 offset, int n)
+{
+	const int end = lowerBound(offset);
+	return entries(end - n, end);
+}
+
+// binary search over the record offsets
+int LogIndex::lowerBound(quint64 offset)
+{
+	int low = 0;
+	int high = count_;
+	while (low < high)
+	{
+		const int mid = low + (high - low) / 2;
+		Entry entry;
+		if (!readEntry(mid, entry))
+			return count_;
+		if (entry.offset < offset)
+			low = mid + 1;
+		else
+			high = mid;
+	}
+	return low;
+}
+
+bool LogIndex::matches(const Entry& entry, const char* data, qint64 size)
+{
+	if (entry.offset + entry.length > static_cast<quint64>(size))
+		return false;
+	LogLine line;
+	const char* begin = data + entry.offset;
+	return LogScanner::scan(begin, begin + entry.length, line) && line.uid.startsWith(entry.uid);
+}
+
+qint64 LogIndex::parseTimestamp(const QByteArray& time)
+{
+	const QDateTime dateTime = QDateTime::fromString(QString::fromLatin1(time), "yyyy-MM-dd hh:mm:ss");
+	return dateTime.isValid() ? dateTime.toSecsSinceEpoch() : 0;
+}
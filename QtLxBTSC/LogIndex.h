@@ -0,0 +1,59 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QFile>
+#include <QVector>
+
+// sidecar file holding the position of every text message in a chat log,
+// records have a fixed size so any message can be found without scanning
+class LogIndex
+{
+public:
+	struct Entry
+	{
+		quint64 offset;
+		quint32 length;
+		qint64 timestamp;
+		QByteArray uid;
+	};
+
+	LogIndex(const QString& indexPath);
+	~LogIndex();
+
+	// index lines appended to the mapped log since the last update,
+	// the index is rebuilt if the log was truncated or rewritten
+	bool update(const QString& logPath, const char* data, qint64 size);
+	int count() const;
+	// first entry starting at or after offset
+	int lowerBound(quint64 offset);
+	QVector<Entry> entries(int from, int to);
+	QVector<Entry> last(int n);
+	QVector<Entry> before(quint64 offset, int n);
+	// logged "yyyy-MM-dd hh:mm:ss" as seconds since epoch, 0 if it can't be read
+	static qint64 parseTimestamp(const QByteArray& time);
+
+private:
+	const static quint32 magic = 0x4c584249; // LXBI
+	const static quint32 version = 2;
+	// magic, version, indexed log size, log modification time, record count
+	const static int headerSize = 28;
+	const static int uidSize = 28;
+	const static int recordSize = 8 + 4 + 8 + uidSize;
+
+	QFile file;
+	quint64 indexedSize;
+	qint64 indexedModified;
+	int count_;
+
+	bool open();
+	void reset();
+	void writeHeader();
+	bool readEntry(int i, Entry& entry);
+	static bool matches(const Entry& entry, const char* data, qint64 size);
+};
@@ -9,80 +9,176 @@
 #include <QJsonArray>
 #include <QJsonObject>
 #include "globals.h"
-#include <QRegularExpression>
-#include <QBuffer>
+#include "LogScanner.h"
+#include "LogIndex.h"
+#include <QVector>
 #include <utils.h>
+#include <QFileInfo>
+#include <QDateTime>
+#include <cstring>
 
-QJsonObject LogReader::readLog(const QString& serverUniqueID)
+QJsonArray LogReader::readPage(const QString& serverUniqueID, const QString& name, qint64 before, int count)
 {
-	QJsonObject obj;
-	const QString chatsPath = QString("%1chats/%2").arg(configPath).arg(serverUniqueID);
-	QByteArray log = readFile(QString("%1/server.html").arg(chatsPath));
-	QJsonArray array = parseMessages(log);
-	obj.insert("server", array);
-
-	log = readFile(QString("%1/channel.html").arg(chatsPath));
-	array = parseMessages(log);
-	obj.insert("channel", array);
-	return obj;
+	return readMessages(logPath(serverUniqueID, name), indexPath(serverUniqueID, name), before, qBound(0, count, maxMessages));
 }
 
-QJsonArray LogReader::readPrivateLog(const QString& serverUniqueID, const QString& clientUniqueID)
+// single message found through the search index
+QJsonObject LogReader::readMessage(const QString& serverUniqueID, const QString& name, qint64 offset, int length)
 {
-	const QString filePath = QString("%1chats/%2/clients/%3.html").arg(configPath, serverUniqueID, clientUniqueID);
-	QByteArray log = readFile(filePath);
-	QJsonArray array = parseMessages(log);
-	return array;
+	QJsonObject message;
+	QFile file(logPath(serverUniqueID, name));
+	if (!file.open(QIODevice::ReadOnly) || offset + length > file.size())
+	{
+		return message;
+	}
+
+	uchar* mapped = file.map(offset, length);
+	if (mapped == nullptr)
+	{
+		return message;
+	}
+
+	const char* begin = reinterpret_cast<const char*>(mapped);
+	if (parseLine(begin, begin + length, message))
+	{
+		message.insert("offset", static_cast<double>(offset));
+	}
+	file.unmap(mapped);
+	return message;
+}
+
+QString LogReader::logPath(const QString& serverUniqueID, const QString& name)
+{
+	return QString("%1chats/%2/%3.html").arg(configPath, serverUniqueID, name);
+}
+
+// index files are kept in the plugin directory, mirroring the layout of the logs
+QString LogReader::indexPath(const QString& serverUniqueID, const QString& name)
+{
+	return QString("%1LxBTSC/history/%2/%3.idx").arg(pluginPath, serverUniqueID, name);
 }
 
-QByteArray LogReader::readFile(const QString& filePath)
+QJsonArray LogReader::readMessages(const QString& filePath, const QString& indexPath, qint64 before, int count)
 {
+	if (!QFileInfo::exists(filePath))
+	{
+		return QJsonArray();
+	}
+
 	QFile file(filePath);
-	if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+	if (!file.open(QIODevice::ReadOnly))
 	{
 		logInfo("LogReader: failed to open file");
-		return "";
+		return QJsonArray();
+	}
+
+	const qint64 size = file.size();
+	if (size == 0)
+	{
+		return QJsonArray();
 	}
 
-	if (file.size() > maxBytesToRead)
+	uchar* mapped = file.map(0, size);
+	if (mapped == nullptr)
 	{
-		file.seek(file.size() - maxBytesToRead);
+		logInfo("LogReader: failed to map file");
+		return QJsonArray();
 	}
 
-	QByteArray r = file.read(maxBytesToRead);
-	file.close();
-	return r;
+	const char* data = reinterpret_cast<const char*>(mapped);
+	const qint64 end = before < 0 ? size : qMin(before, size);
+	bool ok;
+	QJsonArray array = readIndexed(filePath, indexPath, data, size, before, count, ok);
+	if (!ok)
+	{
+		logInfo("LogReader: index not available");
+		array = readBackwards(data, end, count);
+	}
+	file.unmap(mapped);
+	return array;
 }
 
-QJsonArray LogReader::parseMessages(const QByteArray& log)
+// bring the index up to date and parse only the lines it points at
+QJsonArray LogReader::readIndexed(const QString& filePath, const QString& indexPath, const char* data, qint64 size, qint64 before, int count, bool& ok)
 {
-	const static QRegularExpression re(R"(&lt;(.*)&gt;.*(client://\d+/(.+)~(.+))\">.*TextMessage_Text\">(.*?)</span>)");
-
 	QJsonArray array;
-	QBuffer buffer;
-	buffer.open(QBuffer::ReadWrite);
-	buffer.write(log);
-	buffer.seek(0);
-	while (buffer.canReadLine())
+	LogIndex index(indexPath);
+	ok = index.update(filePath, data, size);
+	if (!ok)
+	{
+		return array;
+	}
+
+	const QVector<LogIndex::Entry> entries = before < 0 ? index.last(count) : index.before(before, count);
+	for (const LogIndex::Entry& entry : entries)
 	{
-		QByteArray line = buffer.readLine();
-		QRegularExpressionMatch match = re.match(line);
-		if (match.hasMatch())
+		const char* begin = data + entry.offset;
+		QJsonObject message;
+		if (parseLine(begin, begin + entry.length, message))
 		{
-			QJsonObject message;
-			QString time = match.captured(1);
-			QString link = match.captured(2);
-			QString uid = match.captured(3);
-			QString name = match.captured(4);
-			QString text = match.captured(5);
-
-			message.insert("time", time);
-			message.insert("link", link);
-			message.insert("uid", utils::ts3WeirdBase16(uid));
-			message.insert("name", name);
-			message.insert("text", text);
+			message.insert("offset", static_cast<double>(entry.offset));
 			array.append(message);
 		}
 	}
 	return array;
 }
+
+// walk the mapped log backwards from the end one line at a time,
+// only the pages holding the newest messages are ever touched
+QJsonArray LogReader::readBackwards(const char* data, qint64 size, int count)
+{
+	const char* end = data + size;
+	QVector<QJsonObject> messages;
+	while (messages.size() < count)
+	{
+		const char* begin = end;
+		while (begin > data && begin[-1] != '\n')
+		{
+			--begin;
+		}
+
+		// line endings are not translated when mapping
+		const char* lineEnd = end;
+		if (lineEnd > begin && lineEnd[-1] == '\r')
+		{
+			--lineEnd;
+		}
+
+		QJsonObject message;
+		if (parseLine(begin, lineEnd, message))
+		{
+			message.insert("offset", static_cast<double>(begin - data));
+			messages.append(message);
+		}
+
+		if (begin == data)
+		{
+			break;
+		}
+		end = begin - 1;
+	}
+
+	// collected newest first, page expects oldest first
+	QJsonArray array;
+	for (int i = messages.size() - 1; i >= 0; --i)
+	{
+		array.append(messages.at(i));
+	}
+	return array;
+}
+
+bool LogReader::parseLine(const char* begin, const char* end, QJsonObject& message)
+{
+	LogLine line;
+	if (!LogScanner::scan(begin, end, line))
+	{
+		return false;
+	}
+
+	message.insert("time", QString::fromUtf8(line.time));
+	message.insert("link", QString::fromUtf8(line.link));
+	message.insert("uid", utils::ts3WeirdBase16(QString::fromLatin1(line.uid)));
+	message.insert("name", QString::fromUtf8(line.name));
+	message.insert("text", QString::fromUtf8(line.text));
+	return true;
+}
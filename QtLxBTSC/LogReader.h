@@ -8,15 +8,23 @@
 #pragma once
 
 #include <QFile>
+#include <QJsonArray>
 
 class LogReader
 {
 public:
-	static QJsonObject readLog(const QString& serverUniqueID);
-	static QJsonArray readPrivateLog(const QString& serverUniqueID, const QString& clientUniqueID);
+	// count messages before the byte offset cursor, messages carry their own offset for the next page
+	static QJsonArray readPage(const QString& serverUniqueID, const QString& name, qint64 before, int count);
+	static QJsonObject readMessage(const QString& serverUniqueID, const QString& name, qint64 offset, int length);
+	static QString logPath(const QString& serverUniqueID, const QString& name);
+	static QString indexPath(const QString& serverUniqueID, const QString& name);
+
+	// upper bound of the "Max lines of history" setting
+	const static int maxMessages = 500;
 
 private:
-	const static int maxBytesToRead = 524288;
-	static QByteArray readFile(const QString& filePath);
-	static QJsonArray parseMessages(const QByteArray& log);
-};
\ No newline at end of file
+	static QJsonArray readMessages(const QString& filePath, const QString& indexPath, qint64 before, int count);
+	static QJsonArray readIndexed(const QString& filePath, const QString& indexPath, const char* data, qint64 size, qint64 before, int count, bool& ok);
+	static QJsonArray readBackwards(const char* data, qint64 size, int count);
+	static bool parseLine(const char* begin, const char* end, QJsonObject& message);
+};
@@ -0,0 +1,182 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "LogScanner.h"
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QRegularExpression>
+#include <cstring>
+
+// single pass over a TeamSpeak html log line, anchors are found in order:
+// &lt;time&gt; ... client://id/uid~name" ... TextMessage_Text">text</span>
+bool LogScanner::scan(const char* begin, const char* end, LogLine& line)
+{
+	const char* timeStart = find(begin, end, "&lt;", 4);
+	if (timeStart == nullptr)
+		return false;
+	timeStart += 4;
+
+	const char* timeEnd = find(timeStart, end, "&gt;", 4);
+	if (timeEnd == nullptr)
+		return false;
+
+	const char* linkStart = find(timeEnd + 4, end, "client://", 9);
+	if (linkStart == nullptr)
+		return false;
+
+	// client id
+	const char* p = linkStart + 9;
+	const char* idStart = p;
+	while (p < end && *p >= '0' && *p <= '9')
+	{
+		++p;
+	}
+	if (p == idStart || p == end || *p != '/')
+		return false;
+
+	const char* uidStart = p + 1;
+	// nickname in the link is html escaped so the first quote closes the href
+	// and the first ~ ends the unique id
+	const char* linkEnd = static_cast<const char*>(memchr(uidStart, '"', end - uidStart));
+	if (linkEnd == nullptr)
+		return false;
+
+	const char* tilde = static_cast<const char*>(memchr(uidStart, '~', linkEnd - uidStart));
+	if (tilde == nullptr || tilde == uidStart || tilde + 1 == linkEnd)
+		return false;
+
+	const char* textStart = find(linkEnd + 1, end, "TextMessage_Text\">", 18);
+	if (textStart == nullptr)
+		return false;
+	textStart += 18;
+
+	const char* textEnd = find(textStart, end, "</span>", 7);
+	if (textEnd == nullptr)
+		return false;
+
+	line.time = view(timeStart, timeEnd);
+	line.link = view(linkStart, linkEnd);
+	line.uid = view(uidStart, tilde);
+	line.name = view(tilde + 1, linkEnd);
+	line.text = view(textStart, textEnd);
+	return true;
+}
+
+// memchr for the first byte, then compare the rest
+const char* LogScanner::find(const char* begin, const char* end, const char* needle, size_t length)
+{
+	while (begin < end && static_cast<size_t>(end - begin) >= length)
+	{
+		const void* hit = memchr(begin, needle[0], (end - begin) - length + 1);
+		if (hit == nullptr)
+			return nullptr;
+
+		const char* candidate = static_cast<const char*>(hit);
+		if (memcmp(candidate + 1, needle + 1, length - 1) == 0)
+			return candidate;
+
+		begin = candidate + 1;
+	}
+	return nullptr;
+}
+
+QByteArray LogScanner::view(const char* begin, const char* end)
+{
+	return QByteArray::fromRawData(begin, static_cast<int>(end - begin));
+}
+
+QString LogScanner::benchmark(const char* begin, const char* end)
+{
+	// the pattern LogReader used before the scanner
+	const static QRegularExpression re(R"(&lt;(.*)&gt;.*(client://\d+/(.+)~(.+))\">.*TextMessage_Text\">(.*?)</span>)");
+
+	int lines = 0;
+	int scanned = 0;
+	QElapsedTimer timer;
+	timer.start();
+	for (const char* lineStart = begin; lineStart < end;)
+	{
+		const char* newline = static_cast<const char*>(memchr(lineStart, '\n', end - lineStart));
+		const char* lineEnd = newline != nullptr ? newline : end;
+		LogLine line;
+		if (scan(lineStart, lineEnd, line))
+		{
+			++scanned;
+		}
+		++lines;
+		lineStart = lineEnd + 1;
+	}
+	const qint64 scanNs = timer.nsecsElapsed();
+
+	int matched = 0;
+	timer.restart();
+	for (const char* lineStart = begin; lineStart < end;)
+	{
+		const char* newline = static_cast<const char*>(memchr(lineStart, '\n', end - lineStart));
+		const char* lineEnd = newline != nullptr ? newline : end;
+		if (re.match(QString::fromUtf8(lineStart, static_cast<int>(lineEnd - lineStart))).hasMatch())
+		{
+			++matched;
+		}
+		lineStart = lineEnd + 1;
+	}
+	const qint64 regexNs = timer.nsecsElapsed();
+
+	const double mib = (end - begin) / (1024.0 * 1024.0);
+	return QString("%1 lines, %2 KiB: scanner %3 ms (%4 MiB/s, %5 messages), regex %6 ms (%7 MiB/s, %8 messages)")
+		.arg(lines).arg((end - begin) / 1024)
+		.arg(scanNs / 1e6, 0, 'f', 2).arg(scanNs > 0 ? mib / (scanNs / 1e9) : 0.0, 0, 'f', 1).arg(scanned)
+		.arg(regexNs / 1e6, 0, 'f', 2).arg(regexNs > 0 ? mib / (regexNs / 1e9) : 0.0, 0, 'f', 1).arg(matched);
+}
+
+QByteArray LogScanner::synthesize(int bytes, int textPercent)
+{
+	static const char* const names[] = { "Luch", "a&amp;b", "Somebody with a long name", "x" };
+	static const char* const words[] = { "hello", "[b]bold[/b]", "https://example.com/some/path?q=1", "&lt;3", "ok", "the", "message" };
+	static const char* const statuses[] = { "TextMessage_ClientConnected", "TextMessage_ClientDisconnected", "TextMessage_ClientMoved" };
+
+	// fixed seed so runs compare
+	quint32 seed = 1;
+	auto next = [&seed](quint32 range)
+	{
+		seed = seed * 1103515245u + 12345u;
+		return (seed >> 16) % range;
+	};
+
+	QByteArray log;
+	log.reserve(bytes + 512);
+	QDateTime time(QDate(2019, 1, 1), QTime(0, 0));
+	while (log.size() < bytes)
+	{
+		time = time.addSecs(next(120));
+		const QByteArray stamp = time.toString("yyyy-MM-dd hh:mm:ss").toLatin1();
+		const quint32 client = next(4);
+		const QByteArray link = QByteArray("client://") + QByteArray::number(client + 1)
+			+ "/uid" + QByteArray::number(client) + "AbCdEfGhIjKlMnOpQrS=~" + names[client];
+
+		if (static_cast<int>(next(100)) < textPercent)
+		{
+			QByteArray text;
+			const quint32 count = 1 + next(30);
+			for (quint32 i = 0; i < count; ++i)
+			{
+				text += words[next(7)];
+				text += ' ';
+			}
+			log += "<p class=\"TextMessage_Normal\"><span class=\"Body\"><img class=\"Incoming\">&lt;" + stamp
+				+ "&gt; <a href=\"" + link + "\" class=\"TextMessage_UserLink\">\"" + names[client]
+				+ "\"</a>: <span class=\"TextMessage_Text\">" + text + "</span></span></p>\n";
+		}
+		else
+		{
+			log += QByteArray("<p class=\"") + statuses[next(3)] + "\"><img class=\"InfoMessage\">&lt;" + stamp
+				+ "&gt; <a href=\"" + link + "\" class=\"TextMessage_UserLink\">\"" + names[client]
+				+ "\"</a> connected to channel</p>\n";
+		}
+	}
+	return log;
+}
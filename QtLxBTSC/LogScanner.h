@@ -0,0 +1,37 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+// fields of one logged text message,
+// these point into the scanned buffer and are only valid as long as it is
+struct LogLine
+{
+	QByteArray time;
+	QByteArray link;
+	QByteArray uid;
+	QByteArray name;
+	QByteArray text;
+};
+
+class LogScanner
+{
+public:
+	static bool scan(const char* begin, const char* end, LogLine& line);
+	// times scan against the regular expression it replaced over every line of a log
+	static QString benchmark(const char* begin, const char* end);
+	// a made up TeamSpeak html log of about bytes, textPercent of the lines are text messages and
+	// the rest status lines, the same arguments always give the same log
+	static QByteArray synthesize(int bytes, int textPercent);
+
+private:
+	static const char* find(const char* begin, const char* end, const char* needle, size_t length);
+	static QByteArray view(const char* begin, const char* end);
+};
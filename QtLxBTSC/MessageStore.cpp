@@ -0,0 +1,458 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "MessageStore.h"
+#include "LogIndex.h"
+#include "LogScanner.h"
+#include "TsClient.h"
+#include "globals.h"
+#include "utils.h"
+#include <QDateTime>
+#include <QDir>
+#include <QFileInfo>
+#include <QJsonObject>
+#include <QtEndian>
+#include <algorithm>
+#include <cstring>
+
+QAtomicInt MessageStore::cacheHits;
+QAtomicInt MessageStore::cacheMisses;
+
+MessageStore::MessageStore(const QString& path, const QString& logPath)
+	: file(path)
+	, logPath(logPath)
+	, size(0)
+	, logSize(0)
+	, logModified(0)
+	, lastImportedTime(0)
+{
+}
+
+MessageStore::~MessageStore()
+{
+	flush();
+	file.close();
+}
+
+QString MessageStore::storePath(const QString& serverUniqueID, const QString& name)
+{
+	return QString("%1LxBTSC/store/%2/%3.lxs").arg(pluginPath, serverUniqueID, name);
+}
+
+bool MessageStore::open()
+{
+	QDir().mkpath(QFileInfo(file.fileName()).absolutePath());
+	if (!file.open(QIODevice::ReadWrite))
+		return false;
+
+	uchar header[headerSize];
+	if (file.size() < headerSize || file.read(reinterpret_cast<char*>(header), headerSize) != headerSize
+		|| qFromLittleEndian<quint32>(header) != magic || qFromLittleEndian<quint32>(header + 4) != version)
+	{
+		// new or unreadable, start over with all of the log
+		file.resize(0);
+		size = headerSize;
+		logSize = 0;
+		logModified = 0;
+		writeHeader();
+		return file.flush() && import();
+	}
+
+	logSize = qFromLittleEndian<qint64>(header + 8);
+	logModified = qFromLittleEndian<qint64>(header + 16);
+	size = file.size();
+	uchar* mapped = file.map(0, size);
+	if (mapped == nullptr)
+		return false;
+
+	// one sequential pass, only the record type and the time of messages are decoded
+	const char* data = reinterpret_cast<const char*>(mapped);
+	const char* p = data + headerSize;
+	const char* end = data + size;
+	while (p < end)
+	{
+		const char* recordStart = p;
+		quint64 length;
+		if (!readVarint(p, end, length) || length == 0 || length > static_cast<quint64>(end - p))
+		{
+			// torn write, drop what is left
+			logInfo("MessageStore: truncating incomplete record");
+			size = recordStart - data;
+			break;
+		}
+
+		const char* payload = p;
+		p += length;
+		const quint8 type = static_cast<quint8>(*payload);
+		if (type == UidRecord)
+		{
+			const QByteArray uid(payload + 1, static_cast<int>(length - 1));
+			uidIds.insert(uid, uids.size());
+			uids.append(uid);
+		}
+		else if (type == MessageRecord)
+		{
+			const char* q = payload + 1;
+			quint64 timestamp;
+			if (readVarint(q, p, timestamp))
+			{
+				offsets.append(recordStart - data);
+				timestamps.append(qMax(timestamps.isEmpty() ? 0 : timestamps.last(), static_cast<qint64>(timestamp)));
+			}
+		}
+	}
+	file.unmap(mapped);
+
+	if (size < file.size())
+	{
+		file.resize(size);
+	}
+	return import();
+}
+
+// the part of the log written since the store last caught up, all of it if the log was rewritten
+bool MessageStore::import()
+{
+	QFile log(logPath);
+	if (!log.open(QIODevice::ReadOnly))
+		return true;
+
+	const qint64 currentSize = log.size();
+	const qint64 modified = QFileInfo(logPath).lastModified().toMSecsSinceEpoch();
+	qint64 from = logSize;
+	if (currentSize < logSize || (currentSize == logSize && modified != logModified))
+	{
+		from = 0;
+	}
+	if (currentSize == from)
+		return true;
+
+	uchar* mapped = log.map(0, currentSize);
+	if (mapped == nullptr)
+		return false;
+
+	const char* data = reinterpret_cast<const char*>(mapped);
+	const char* lineStart = data + from;
+	const char* end = data + currentSize;
+	// a line being written when the store caught up was stored live
+	if (from > 0 && data[from - 1] != '\n')
+	{
+		const char* newline = static_cast<const char*>(memchr(lineStart, '\n', end - lineStart));
+		lineStart = newline != nullptr ? newline + 1 : end;
+	}
+	// a partially written last line is picked up next time
+	while (end > lineStart && end[-1] != '\n')
+	{
+		--end;
+	}
+
+	qint64 lastTime = 0;
+	QByteArray lastUid;
+	while (lineStart < end)
+	{
+		const char* newline = static_cast<const char*>(memchr(lineStart, '\n', end - lineStart));
+		const char* lineEnd = newline != nullptr ? newline : end;
+		LogLine line;
+		if (LogScanner::scan(lineStart, lineEnd, line))
+		{
+			// client://<id>/
+			const int slash = line.link.indexOf('/', 9);
+			Message message;
+			message.timestamp = LogIndex::parseTimestamp(line.time);
+			message.uid = QByteArray(line.uid.constData(), line.uid.size());
+			message.clientId = static_cast<quint16>(line.link.mid(9, slash - 9).toUShort());
+			message.outgoing = false;
+			message.html = true;
+			message.name = QString::fromUtf8(line.name);
+			message.text = QString::fromUtf8(line.text);
+			append(message);
+			lastTime = message.timestamp;
+			lastUid = message.uid;
+		}
+		lineStart = lineEnd + 1;
+	}
+	logSize = end - data;
+	logModified = modified;
+	log.unmap(mapped);
+	if (!flush())
+		return false;
+
+	lastImportedTime = lastTime;
+	lastImportedUid = lastUid;
+	return true;
+}
+
+bool MessageStore::justImported(qint64 timestamp, const QByteArray& uid) const
+{
+	return !lastImportedUid.isEmpty() && lastImportedUid == uid && qAbs(lastImportedTime - timestamp) <= 1;
+}
+
+void MessageStore::writeHeader()
+{
+	uchar header[headerSize];
+	qToLittleEndian<quint32>(magic, header);
+	qToLittleEndian<quint32>(version, header + 4);
+	qToLittleEndian<qint64>(logSize, header + 8);
+	qToLittleEndian<qint64>(logModified, header + 16);
+	file.seek(0);
+	file.write(reinterpret_cast<const char*>(header), headerSize);
+}
+
+quint32 MessageStore::intern(const QByteArray& uid)
+{
+	auto it = uidIds.constFind(uid);
+	if (it != uidIds.constEnd())
+		return it.value();
+
+	QByteArray payload;
+	payload.append(static_cast<char>(UidRecord));
+	payload.append(uid);
+	appendRecord(payload);
+
+	const quint32 id = static_cast<quint32>(uids.size());
+	uidIds.insert(uid, id);
+	uids.append(uid);
+	return id;
+}
+
+void MessageStore::append(const Message& message)
+{
+	lastImportedUid.clear();
+	const quint32 uidId = intern(message.uid);
+	const QByteArray name = message.name.toUtf8();
+
+	QByteArray payload;
+	payload.append(static_cast<char>(MessageRecord));
+	writeVarint(payload, static_cast<quint64>(qMax<qint64>(0, message.timestamp)));
+	writeVarint(payload, uidId);
+	writeVarint(payload, message.clientId);
+	payload.append(static_cast<char>((message.outgoing ? Outgoing : 0) | (message.html ? Html : 0)));
+	writeVarint(payload, static_cast<quint64>(name.size()));
+	payload.append(name);
+	payload.append(message.text.toUtf8());
+
+	offsets.append(size + pending.size());
+	timestamps.append(qMax(timestamps.isEmpty() ? 0 : timestamps.last(), message.timestamp));
+	appendRecord(payload);
+
+	// nothing decoded yet stays that way, an import doesn't build objects nobody asked for
+	if (recent.isEmpty())
+		return;
+
+	recent.append(toJson(offsets.last(), qMax<qint64>(0, message.timestamp), message.uid, message.clientId,
+		static_cast<quint8>((message.outgoing ? Outgoing : 0) | (message.html ? Html : 0)), message.name, message.text));
+	if (recent.size() > recentSize)
+	{
+		recent.removeFirst();
+	}
+}
+
+void MessageStore::appendRecord(const QByteArray& payload)
+{
+	writeVarint(pending, static_cast<quint64>(payload.size()));
+	pending.append(payload);
+}
+
+bool MessageStore::dirty() const
+{
+	return !pending.isEmpty();
+}
+
+// group commit, everything appended since the last flush goes out in one write
+bool MessageStore::flush()
+{
+	if (pending.isEmpty())
+		return true;
+
+	file.seek(size);
+	if (file.write(pending) != pending.size() || !file.flush())
+	{
+		logError("MessageStore: write failed");
+		file.resize(size);
+		return false;
+	}
+	size += pending.size();
+	pending.clear();
+
+	// while the plugin runs everything TeamSpeak logs is stored live as well,
+	// so the log up to now doesn't have to be imported next time
+	const QFileInfo info(logPath);
+	if (info.exists() && info.size() > logSize)
+	{
+		logSize = info.size();
+		logModified = info.lastModified().toMSecsSinceEpoch();
+	}
+	writeHeader();
+	return file.flush();
+}
+
+QJsonArray MessageStore::last(int n)
+{
+	return before(size + pending.size(), n);
+}
+
+QJsonArray MessageStore::before(qint64 offset, int n)
+{
+	const int end = static_cast<int>(std::lower_bound(offsets.constBegin(), offsets.constEnd(), offset) - offsets.constBegin());
+	const int from = qMax(0, end - n);
+	if (from >= offsets.size() - recent.size())
+	{
+		cacheHits.ref();
+		return cached(from, end);
+	}
+
+	cacheMisses.ref();
+	const QJsonArray array = read(from, end);
+	remember(array, from, end);
+	return array;
+}
+
+QJsonArray MessageStore::cached(int from, int to) const
+{
+	QJsonArray array;
+	const int first = offsets.size() - recent.size();
+	for (int i = from; i < to; ++i)
+	{
+		array.append(recent.at(i - first));
+	}
+	return array;
+}
+
+// only a complete read up to the newest message can be kept, recent has no gaps
+void MessageStore::remember(const QJsonArray& messages, int from, int to)
+{
+	if (to != offsets.size() || messages.size() != to - from || messages.size() <= recent.size())
+		return;
+
+	recent.clear();
+	for (int i = qMax(0, messages.size() - recentSize); i < messages.size(); ++i)
+	{
+		recent.append(messages.at(i).toObject());
+	}
+}
+
+QString MessageStore::cacheStats()
+{
+	return QString("History cache: %1 pages decoded before, %2 read from disk").arg(cacheHits.load()).arg(cacheMisses.load());
+}
+
+qint64 MessageStore::offsetAfter(qint64 timestamp) const
+{
+	const int i = static_cast<int>(std::upper_bound(timestamps.constBegin(), timestamps.constEnd(), timestamp) - timestamps.constBegin());
+	return i < offsets.size() ? offsets.at(i) : size + pending.size();
+}
+
+qint64 MessageStore::locate(qint64 timestamp, const QByteArray& uid)
+{
+	if (timestamp <= 0 || uid.isEmpty() || !flush())
+		return -1;
+
+	// only the head of each message of that second is decoded
+	const auto range = std::equal_range(timestamps.constBegin(), timestamps.constEnd(), timestamp);
+	for (auto it = range.first; it != range.second; ++it)
+	{
+		const qint64 offset = offsets.at(static_cast<int>(it - timestamps.constBegin()));
+		file.seek(offset);
+		const QByteArray head = file.read(32);
+		const char* p = head.constData();
+		const char* end = p + head.size();
+		quint64 length, time, uidId;
+		if (readVarint(p, end, length) && p < end && static_cast<quint8>(*p++) == MessageRecord
+			&& readVarint(p, end, time) && readVarint(p, end, uidId)
+			&& uidId < static_cast<quint64>(uids.size()) && uids.at(static_cast<int>(uidId)).startsWith(uid))
+			return offset;
+	}
+	return -1;
+}
+
+QJsonArray MessageStore::read(int from, int to)
+{
+	QJsonArray array;
+	if (from >= to || !flush())
+		return array;
+
+	// the range is read in one go and decoded front to back
+	const qint64 begin = offsets.at(from);
+	const qint64 end = to < offsets.size() ? offsets.at(to) : size;
+	file.seek(begin);
+	const QByteArray data = file.read(end - begin);
+	const char* p = data.constData();
+	const char* dataEnd = p + data.size();
+	while (p < dataEnd)
+	{
+		const qint64 offset = begin + (p - data.constData());
+		quint64 length;
+		if (!readVarint(p, dataEnd, length) || length > static_cast<quint64>(dataEnd - p))
+			break;
+
+		const char* payload = p;
+		const char* payloadEnd = p + length;
+		p = payloadEnd;
+		if (length == 0 || static_cast<quint8>(*payload) != MessageRecord)
+			continue;
+
+		const char* q = payload + 1;
+		quint64 timestamp, uidId, clientId, nameLength;
+		if (!readVarint(q, payloadEnd, timestamp) || !readVarint(q, payloadEnd, uidId) || !readVarint(q, payloadEnd, clientId)
+			|| q >= payloadEnd || uidId >= static_cast<quint64>(uids.size()))
+			continue;
+		const quint8 flags = static_cast<quint8>(*q++);
+		if (!readVarint(q, payloadEnd, nameLength) || nameLength > static_cast<quint64>(payloadEnd - q))
+			continue;
+
+		const QString name = QString::fromUtf8(q, static_cast<int>(nameLength));
+		q += nameLength;
+		const QString text = QString::fromUtf8(q, static_cast<int>(payloadEnd - q));
+		array.append(toJson(offset, static_cast<qint64>(timestamp), uids.at(static_cast<int>(uidId)), static_cast<quint16>(clientId), flags, name, text));
+	}
+	return array;
+}
+
+QJsonObject MessageStore::toJson(qint64 offset, qint64 timestamp, const QByteArray& uid, quint16 clientId, quint8 flags, const QString& name, const QString& text)
+{
+	const QString id = QString::fromLatin1(uid);
+	QJsonObject message;
+	message.insert("time", QDateTime::fromSecsSinceEpoch(timestamp).toString("yyyy-MM-dd hh:mm:ss"));
+	message.insert("uid", utils::ts3WeirdBase16(id));
+	message.insert("name", name);
+	message.insert("offset", static_cast<double>(offset));
+	if (flags & Html)
+	{
+		// names in html logs are already escaped
+		message.insert("link", QString("client://%1/%2~%3").arg(QString::number(clientId), id, name));
+		message.insert("text", text);
+	}
+	else
+	{
+		message.insert("link", TsClient::link(clientId, id, name));
+		message.insert("line", text);
+	}
+	return message;
+}
+
+void MessageStore::writeVarint(QByteArray& out, quint64 value)
+{
+	while (value >= 0x80)
+	{
+		out.append(static_cast<char>((value & 0x7f) | 0x80));
+		value >>= 7;
+	}
+	out.append(static_cast<char>(value));
+}
+
+bool MessageStore::readVarint(const char*& p, const char* end, quint64& value)
+{
+	value = 0;
+	for (int shift = 0; p < end && shift < 64; shift += 7)
+	{
+		const quint8 byte = static_cast<quint8>(*p++);
+		value |= static_cast<quint64>(byte & 0x7f) << shift;
+		if (!(byte & 0x80))
+			return true;
+	}
+	return false;
+}
@@ -0,0 +1,102 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QFile>
+#include <QHash>
+#include <QVector>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QList>
+#include <QAtomicInt>
+
+// append only binary log of one chat tab, written by the plugin itself so history
+// can be read back without parsing TeamSpeak's html logs
+//
+// header: "LXBS" version, size and modification time of the TeamSpeak log when it was last caught up with,
+// then records of varint length + payload
+//   uid:     1, unique id bytes                 (ids are numbered in order of appearance)
+//   message: 2, varint time, varint uid id, varint client id, flags, varint name length, name, text
+class MessageStore
+{
+public:
+	struct Message
+	{
+		qint64 timestamp;
+		QByteArray uid;
+		quint16 clientId;
+		bool outgoing;
+		bool html;        // imported from an html log, text is markup instead of bbcode
+		QString name;
+		QString text;
+	};
+
+	MessageStore(const QString& path, const QString& logPath);
+	~MessageStore();
+
+	static QString storePath(const QString& serverUniqueID, const QString& name);
+
+	// read the records once to find messages and interned ids, a torn last record is cut off,
+	// then copy what TeamSpeak logged while nobody was storing, all of the log for a new store
+	bool open();
+	// buffered until the next flush
+	void append(const Message& message);
+	// the newest imported message, if nothing was appended since, TeamSpeak may have
+	// logged a message before the plugin got to store it
+	bool justImported(qint64 timestamp, const QByteArray& uid) const;
+	bool flush();
+	bool dirty() const;
+
+	// same shape as LogReader pages, offsets are positions in the store,
+	// the newest messages are kept decoded so switching tabs doesn't touch the disk
+	QJsonArray last(int n);
+	QJsonArray before(qint64 offset, int n);
+	// cursor for a page that ends with the messages of this second
+	qint64 offsetAfter(qint64 timestamp) const;
+	// offset of a message from this sender at this time, -1 if there is none
+	qint64 locate(qint64 timestamp, const QByteArray& uid);
+	// pages served from the decoded messages against those read from disk, all stores together
+	static QString cacheStats();
+
+private:
+	const static quint32 magic = 0x5342584c; // LXBS
+	const static quint32 version = 2;
+	const static int headerSize = 24;
+	enum RecordType : quint8 { UidRecord = 1, MessageRecord = 2 };
+	enum Flags : quint8 { Outgoing = 1, Html = 2 };
+
+	QFile file;
+	const QString logPath;
+	qint64 size;      // bytes written, pending records come after
+	qint64 logSize;   // the TeamSpeak log up to here is in the store
+	qint64 logModified;
+	qint64 lastImportedTime;
+	QByteArray lastImportedUid;
+	QByteArray pending;
+	QVector<qint64> offsets;
+	QVector<qint64> timestamps;   // never decreasing, a time that couldn't be read counts as the one before
+	QVector<QByteArray> uids;
+	QHash<QByteArray, quint32> uidIds;
+	// the last messages decoded, recent.last() is the message at offsets.last()
+	const static int recentSize = 500;
+	QList<QJsonObject> recent;
+	static QAtomicInt cacheHits;
+	static QAtomicInt cacheMisses;
+
+	quint32 intern(const QByteArray& uid);
+	void appendRecord(const QByteArray& payload);
+	bool import();
+	void writeHeader();
+	QJsonArray read(int from, int to);
+	// the newest messages of read(from, to) replace recent
+	void remember(const QJsonArray& messages, int from, int to);
+	QJsonArray cached(int from, int to) const;
+	static QJsonObject toJson(qint64 offset, qint64 timestamp, const QByteArray& uid, quint16 clientId, quint8 flags, const QString& name, const QString& text);
+	static void writeVarint(QByteArray& out, quint64 value);
+	static bool readVarint(const char*& p, const char* end, quint64& value);
+};
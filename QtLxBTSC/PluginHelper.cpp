@@ -8,23 +8,46 @@
 #include "PluginHelper.h"
 #include "utils.h"
 #include <QTimer>
+#include <QSet>
 #include <QMenuBar>
 #include <QToolButton>
 #include <QApplication>
 #include <QFileDialog>
 #include <QJsonArray>
-#include "LogReader.h"
+#include <QDateTime>
+#include "MessageStore.h"
+#include "StatusText.h"
+#include "UidPool.h"
 
 PluginHelper::PluginHelper(const QString& pluginPath, QObject *parent)
 	: QObject(parent)
+	, chatTabWidget(nullptr)
 	, wObject(new TsWebObject(this))
 	, config(new ConfigWidget(pluginPath))
 	, transfers(new FileTransferListWidget())
 	, chat(new ChatWidget(pluginPath, this->wObject))
 	, pluginPath(pluginPath)
+	, currentState(Qt::ApplicationActive)
+	, historyLoader(new HistoryLoader())
+	, lastHistoryRequest(0)
+	, pendingSearch(0)
 {
+	// history is read from disk on its own thread
+	historyLoader->moveToThread(&historyThread);
+	// its timers and file watcher belong to the thread, so it is deleted there
+	connect(&historyThread, &QThread::finished, historyLoader, &QObject::deleteLater);
+	connect(historyLoader, &HistoryLoader::logRead, this, &PluginHelper::onLogRead);
+	connect(historyLoader, &HistoryLoader::privateLogRead, this, &PluginHelper::onPrivateLogRead);
+	connect(historyLoader, &HistoryLoader::pageRead, this, &PluginHelper::onPageRead);
+	connect(historyLoader, &HistoryLoader::searchDone, this, &PluginHelper::onSearchDone);
+	connect(historyLoader, &HistoryLoader::benchmarkDone, this, &PluginHelper::onPrintConsoleMessageToCurrentTab);
+	connect(wObject, &TsWebObject::historyPageRequested, this, &PluginHelper::onHistoryPageRequested);
+	connect(wObject, &TsWebObject::historySearchRequested, this, &PluginHelper::onHistorySearchRequested);
+	historyThread.start();
+	QMetaObject::invokeMethod(historyLoader, "updateSearchIndex", Qt::QueuedConnection);
+
+	// emotes are sent once the page is ready
 	utils::makeEmoteJsonArray(pluginPath);
-	emit wObject->loadEmotes();
 	onConfigChanged();
 
 	connect(this, &PluginHelper::triggerReloadEmotes, this, &PluginHelper::reloadEmotes);
@@ -33,7 +56,9 @@ PluginHelper::PluginHelper(const QString& pluginPath, QObject *parent)
 	connect(chat, &ChatWidget::clientUrlClicked, this, &PluginHelper::onClientUrlClicked);
 	connect(chat, &ChatWidget::channelUrlClicked, this, &PluginHelper::onChannelUrlClicked);
 	connect(chat, &ChatWidget::linkHovered, this, &PluginHelper::onLinkHovered);
-	connect(chat, &ChatWidget::pageReloaded, this, &PluginHelper::onReloaded);
+	connect(wObject, &TsWebObject::pageReady, this, &PluginHelper::onPageReady);
+	connect(wObject, &TsWebObject::unreadChanged, this, &PluginHelper::updateUnread);
+	connect(qApp, &QGuiApplication::applicationStateChanged, this, &PluginHelper::onApplicationStateChanged);
 	connect(transfers, &FileTransferListWidget::transferFailed, this, &PluginHelper::onTransferFailure);
 	connect(config, &ConfigWidget::configChanged, wObject, &TsWebObject::configChanged);
 	connect(config, &ConfigWidget::configChanged, this, &PluginHelper::onConfigChanged);
@@ -44,6 +69,8 @@ PluginHelper::PluginHelper(const QString& pluginPath, QObject *parent)
 
 PluginHelper::~PluginHelper()
 {
+	historyThread.quit();
+	historyThread.wait();
 	delete chatMenu;
 	delete chat;
 	delete config;
@@ -69,6 +96,7 @@ void PluginHelper::initUi()
 	chatTabWidget->setMaximumHeight(chatTabWidget->tabBar()->height());
 
 	connect(chatTabWidget, &QTabWidget::currentChanged, this, &PluginHelper::onTabChange);
+	connect(chatTabWidget, &QTabWidget::tabCloseRequested, this, &PluginHelper::onTabCloseRequested);
 	chatTabWidget->setMovable(false);
 
 	chatLineEdit = qobject_cast<QTextEdit*>(utils::findWidget("ChatLineEdit", parent));
@@ -92,17 +120,24 @@ void PluginHelper::insertMenu()
 	QAction* toggle = new QAction("&Toggle Chat", chatMenu);
 	QAction* browseDirectory = new QAction("&Browse Directory", debug);
 	QAction* reloademotes = new QAction("&Reload Emotes", debug);
-	QAction* reloadchat = new QAction("&Clear and Reload Chat", debug);
+	QAction* reloadchat = new QAction("Re&load Chat", debug);
+	QAction* clearchat = new QAction("&Clear Chat", debug);
+	QAction* stats = new QAction("&Statistics", debug);
 	connect(settings, &QAction::triggered, [this]() { openConfig(); });
 	connect(transfers, &QAction::triggered, [this]() { openTransfers(); });
 	connect(toggle, &QAction::triggered, [this]() { toggleNormalChat(); });
 	connect(browseDirectory, &QAction::triggered, [this]() { QDesktopServices::openUrl(QUrl::fromLocalFile(pluginPath + "LxBTSC/template")); });
 	connect(reloademotes, &QAction::triggered, [this]() { fullReloadEmotes(); });
-	connect(reloadchat, &QAction::triggered, [this]() { chat->reload(); });
+	connect(reloadchat, &QAction::triggered, [this]() { reload(); });
+	connect(clearchat, &QAction::triggered, [this]() { clearChat(); });
+	connect(stats, &QAction::triggered, [this]() { printStats(); });
 	debug->addAction(browseDirectory);
 	debug->addSeparator();
 	debug->addAction(reloademotes);
 	debug->addAction(reloadchat);
+	debug->addAction(clearchat);
+	debug->addSeparator();
+	debug->addAction(stats);
 	chatMenu->addAction(settings);
 	chatMenu->addAction(transfers);
 	chatMenu->addAction(toggle);
@@ -113,7 +148,7 @@ void PluginHelper::insertMenu()
 }
 
 // Receive chat tab changed signal
-void PluginHelper::onTabChange(int i) const
+void PluginHelper::onTabChange(int i)
 {
 	int mode;
 	QString server;
@@ -121,20 +156,15 @@ void PluginHelper::onTabChange(int i) const
 	std::tie(mode, server, client) = getTab(i);
 	if (mode == 0)
 		return;
+
+	// the tabs are replaced when switching servers
+	updateUnread();
 	
 	if (client != nullptr)
 	{
 		if (config->getConfigAsBool("HISTORY_ENABLED") && !client->historyRead())
 		{
-			QJsonObject json
-			{
-				{"type", "privateChatLog"},
-				{"target", server},
-				{"client", client->safeUniqueId()},
-				{"log", LogReader::readPrivateLog(server, client->uniqueId().toLatin1().toBase64())}
-			};
-			emit wObject->sendMessage(json);
-			client->setHistoryRead();
+			requestPrivateHistory(getServer(ts3Functions.getCurrentServerConnectionHandlerID()), client);
 		}
 		
 		emit wObject->tabChanged(server, mode, client->safeUniqueId());
@@ -145,6 +175,290 @@ void PluginHelper::onTabChange(int i) const
 	}
 }
 
+// minimized or in the background, nobody is watching the chat
+void PluginHelper::onApplicationStateChanged(Qt::ApplicationState state)
+{
+	currentState = state;
+	wObject->setLowPower(state != Qt::ApplicationActive);
+}
+
+// messages of hidden tabs are only rendered when the tab is shown, until then the count is in the tooltip
+void PluginHelper::updateUnread() const
+{
+	if (chatTabWidget == nullptr)
+		return;
+
+	for (int i = 0; i < chatTabWidget->count(); ++i)
+	{
+		int mode;
+		QString server;
+		QSharedPointer<TsClient> client;
+		std::tie(mode, server, client) = getTab(i);
+		const int count = mode == 0 ? 0 : wObject->unreadCount(server, mode, client != nullptr ? client->safeUniqueId() : QString());
+		chatTabWidget->setTabToolTip(i, count > 0 ? QString("%1 unread").arg(count) : QString());
+	}
+}
+
+// private chat closed before its history was read
+void PluginHelper::onTabCloseRequested(int i)
+{
+	int mode;
+	QString server;
+	QSharedPointer<TsClient> client;
+	std::tie(mode, server, client) = getTab(i);
+	if (mode == 1)
+	{
+		cancelHistory(server, client->safeUniqueId());
+		QMetaObject::invokeMethod(historyLoader, "unwatch", Qt::QueuedConnection, Q_ARG(QString, server),
+			Q_ARG(QString, QString("clients/%1").arg(QString(client->uniqueId().toLatin1().toBase64()))));
+		unpinTab(chatTabWidget->widget(i));
+	}
+}
+
+void PluginHelper::requestServerHistory(const QSharedPointer<TsServer>& server)
+{
+	const QString target = server->safeUniqueId();
+	const quint64 requestId = ++lastHistoryRequest;
+	pendingHistory.insert(target, { requestId, server, nullptr });
+	server->setHistoryRead();
+	QMetaObject::invokeMethod(historyLoader, "readLog", Qt::QueuedConnection, Q_ARG(quint64, requestId), Q_ARG(QString, target),
+		Q_ARG(int, config->getConfigAsInt("MAX_HISTORY", 50)));
+}
+
+void PluginHelper::requestPrivateHistory(const QSharedPointer<TsServer>& server, const QSharedPointer<TsClient>& client)
+{
+	const QString target = server->safeUniqueId();
+	const quint64 requestId = ++lastHistoryRequest;
+	pendingHistory.insert(QString("%1/%2").arg(target, client->safeUniqueId()), { requestId, server, client });
+	client->setHistoryRead();
+	QMetaObject::invokeMethod(historyLoader, "readPrivateLog", Qt::QueuedConnection, Q_ARG(quint64, requestId), Q_ARG(QString, target),
+		Q_ARG(QString, client->safeUniqueId()), Q_ARG(QString, client->uniqueId().toLatin1().toBase64()), Q_ARG(int, config->getConfigAsInt("MAX_HISTORY", 50)));
+}
+
+// drop queued history reads, without client everything for the server is cancelled
+void PluginHelper::cancelHistory(const QString& target, const QString& client)
+{
+	const QString privateKey = QString("%1/%2").arg(target, client);
+	auto it = pendingHistory.begin();
+	while (it != pendingHistory.end())
+	{
+		const bool match = client.isEmpty() ? it.key() == target || it.key().startsWith(target + "/") : it.key() == privateKey;
+		if (!match)
+		{
+			++it;
+			continue;
+		}
+
+		historyLoader->cancel(it->requestId);
+		// allow reading again next time the tab is opened
+		if (it->client != nullptr)
+		{
+			it->client->setHistoryRead(false);
+		}
+		else if (it->server != nullptr)
+		{
+			it->server->setHistoryRead(false);
+		}
+		it = pendingHistory.erase(it);
+	}
+}
+
+void PluginHelper::onLogRead(quint64 requestId, const QString& target, const QJsonObject& log)
+{
+	// cancelled or replaced by a newer request
+	if (pendingHistory.value(target).requestId != requestId)
+		return;
+
+	pendingHistory.remove(target);
+	QJsonObject json
+	{
+		{"type", "chatLog"},
+		{"target", target},
+		{"log", log}
+	};
+	wObject->post(json);
+}
+
+// past the threshold the rest of a burst is held back and sent as one summary line when the window closes,
+// other status lines of the server first let out what is held so the tab stays in order
+void PluginHelper::postStatus(const QJsonObject& json)
+{
+	static const QSet<QString> grouped{ "clientConnected", "clientDisconnected", "clientMoveBySelf" };
+	const QString target = json.value("target").toString();
+	const QString kind = json.value("kind").toString();
+	const int threshold = config->getConfigAsInt("EVENT_GROUP_THRESHOLD", 5);
+	if (threshold <= 0 || !grouped.contains(kind))
+	{
+		flushStatusBursts(target, QString());
+		wObject->post(json);
+		return;
+	}
+
+	const QString key = QString("%1/%2").arg(target, kind);
+	flushStatusBursts(target, key);
+	auto it = statusBursts.find(key);
+	if (it == statusBursts.end())
+	{
+		it = statusBursts.insert(key, { 0, QJsonArray() });
+		QTimer::singleShot(config->getConfigAsInt("EVENT_GROUP_WINDOW", 2000), this, [=]() { endStatusBurst(key); });
+	}
+	if (it->shown < threshold)
+	{
+		++it->shown;
+		wObject->post(json);
+	}
+	else
+	{
+		it->held.append(json);
+	}
+}
+
+void PluginHelper::endStatusBurst(const QString& key)
+{
+	auto it = statusBursts.find(key);
+	if (it == statusBursts.end())
+		return;
+
+	if (it->held.isEmpty())
+	{
+		statusBursts.erase(it);
+		return;
+	}
+
+	postHeld(*it);
+	// still going, the next window shows its first lines and sums up the rest as well
+	QTimer::singleShot(config->getConfigAsInt("EVENT_GROUP_WINDOW", 2000), this, [=]() { endStatusBurst(key); });
+}
+
+// held events of the server's other bursts, the bursts themselves go on
+void PluginHelper::flushStatusBursts(const QString& target, const QString& except)
+{
+	const QString prefix = target + "/";
+	for (auto it = statusBursts.begin(); it != statusBursts.end(); ++it)
+	{
+		if (it.key() != except && it.key().startsWith(prefix) && !it->held.isEmpty())
+		{
+			postHeld(*it);
+		}
+	}
+}
+
+void PluginHelper::postHeld(StatusBurst& burst)
+{
+	if (burst.held.size() == 1)
+	{
+		wObject->post(burst.held.first().toObject());
+	}
+	else
+	{
+		const QJsonObject last = burst.held.last().toObject();
+		QJsonObject json
+		{
+			{"type", "statusSummary"},
+			{"target", last.value("target")},
+			{"time", last.value("time")},
+			{"kind", last.value("kind")},
+			{"events", burst.held}
+		};
+		wObject->post(json);
+	}
+	burst.held = QJsonArray();
+	burst.shown = 0;
+}
+
+void PluginHelper::onPrivateLogRead(quint64 requestId, const QString& target, const QString& client, const QJsonArray& log)
+{
+	const QString key = QString("%1/%2").arg(target, client);
+	if (pendingHistory.value(key).requestId != requestId)
+		return;
+
+	pendingHistory.remove(key);
+	QJsonObject json
+	{
+		{"type", "privateChatLog"},
+		{"target", target},
+		{"client", client},
+		{"log", log}
+	};
+	wObject->post(json);
+}
+
+// older history for a tab, requested by the page when scrolled to the top
+void PluginHelper::onHistoryPageRequested(const QString& target, int mode, const QString& client, qint64 before, int count)
+{
+	QString name;
+	switch (mode)
+	{
+	case 3:
+		name = "server";
+		break;
+	case 2:
+		name = "channel";
+		break;
+	case 1:
+		name = QString("clients/%1").arg(QString(utils::fromTs3WeirdBase16(client).toLatin1().toBase64()));
+		break;
+	default:
+		return;
+	}
+
+	const QString key = QString("%1/%2/%3/page").arg(target).arg(mode).arg(client);
+	const quint64 requestId = ++lastHistoryRequest;
+	if (pendingHistory.contains(key))
+	{
+		historyLoader->cancel(pendingHistory.value(key).requestId);
+	}
+	pendingHistory.insert(key, { requestId, nullptr, nullptr });
+	QMetaObject::invokeMethod(historyLoader, "readPage", Qt::QueuedConnection, Q_ARG(quint64, requestId), Q_ARG(QString, target),
+		Q_ARG(int, mode), Q_ARG(QString, client), Q_ARG(QString, name), Q_ARG(qint64, before), Q_ARG(int, count));
+}
+
+void PluginHelper::onPageRead(quint64 requestId, const QString& target, int mode, const QString& client, const QJsonArray& log)
+{
+	const QString key = QString("%1/%2/%3/page").arg(target).arg(mode).arg(client);
+	if (pendingHistory.value(key).requestId != requestId)
+		return;
+
+	pendingHistory.remove(key);
+	QJsonObject json
+	{
+		{"type", "historyPage"},
+		{"target", target},
+		{"mode", mode},
+		{"client", client},
+		{"log", log}
+	};
+	wObject->post(json);
+}
+
+// only the latest search is answered
+void PluginHelper::onHistorySearchRequested(const QString& text, const QString& target, int mode, const QString& sender, qint64 from, qint64 to, int limit)
+{
+	if (pendingSearch != 0)
+	{
+		historyLoader->cancel(pendingSearch);
+	}
+	pendingSearch = ++lastHistoryRequest;
+	QMetaObject::invokeMethod(historyLoader, "search", Qt::QueuedConnection, Q_ARG(quint64, pendingSearch), Q_ARG(QString, text),
+		Q_ARG(QString, target), Q_ARG(int, mode), Q_ARG(QString, sender), Q_ARG(qint64, from), Q_ARG(qint64, to), Q_ARG(int, limit));
+}
+
+void PluginHelper::onSearchDone(quint64 requestId, const QString& text, const QJsonArray& results, bool complete)
+{
+	if (requestId != pendingSearch)
+		return;
+
+	pendingSearch = 0;
+	QJsonObject json
+	{
+		{"type", "searchResults"},
+		{"query", text},
+		{"results", results},
+		{"complete", complete}
+	};
+	wObject->post(json);
+}
+
 std::tuple<int, QString, QSharedPointer<TsClient>> PluginHelper::getTab(int tabIndex) const
 {
 	if (tabIndex >= 0)
@@ -161,10 +475,32 @@ std::tuple<int, QString, QSharedPointer<TsClient>> PluginHelper::getTab(int tabI
 		{
 			return { 2, s->safeUniqueId(), nullptr };
 		}
-		auto c = s->getClientByName(chatTabWidget->tabText(tabIndex));
+		// a private tab is looked up by its text once, after that by its widget
+		QWidget* tab = chatTabWidget->widget(tabIndex);
+		QSharedPointer<TsClient> c;
+		auto known = tabClients.constFind(tab);
+		if (known != tabClients.constEnd() && known->first == s->uniqueId())
+		{
+			c = s->getClientByUid(known->second);
+		}
 		if (c == nullptr)
-			return { 0, "", nullptr };
+		{
+			c = s->getClientByName(chatTabWidget->tabText(tabIndex));
+			if (c == nullptr)
+				return { 0, "", nullptr };
 
+			if (known == tabClients.constEnd())
+			{
+				connect(tab, &QObject::destroyed, const_cast<PluginHelper*>(this), [this](QObject* o) { unpinTab(static_cast<QWidget*>(o)); });
+			}
+			// kept around while the tab is open even if the client leaves
+			s->pin(c->uidHandle());
+			if (known != tabClients.constEnd())
+			{
+				unpinTab(tab);
+			}
+			tabClients.insert(tab, { s->uniqueId(), c->uniqueId() });
+		}
 		return { 1, s->safeUniqueId(), c };
 	}
 	return { 0, "", nullptr };
@@ -369,7 +705,7 @@ void PluginHelper::onPrintConsoleMessage(uint64 serverConnectionHandlerID, QStri
 		{"message", message}
 
 	};
-	emit wObject->sendMessage(json);
+	wObject->post(json);
 }
 
 void PluginHelper::onPrintConsoleMessageToCurrentTab(const QString& message) const
@@ -385,11 +721,11 @@ void PluginHelper::onPrintConsoleMessageToCurrentTab(const QString& message) con
 			{"type", "consoleMessage"},
 			{"target", server},
 			{"mode", mode},
-			{"client", client->safeUniqueId()},
+			{"client", client != nullptr ? client->safeUniqueId() : QString()},
 			{"message", message}
 
 		};
-		emit wObject->sendMessage(json);
+		wObject->post(json);
 	}		
 	else
 	{
@@ -402,12 +738,12 @@ void PluginHelper::onPrintConsoleMessageToCurrentTab(const QString& message) con
 			{"message", message}
 
 		};
-		emit wObject->sendMessage(json);
+		wObject->post(json);
 	}
 		
 }
 
-void PluginHelper::textMessageReceived(uint64 serverConnectionHandlerID, anyID fromID, anyID toID, anyID targetMode, QString senderUniqueID, const QString& fromName, QString message, bool outgoing) const
+void PluginHelper::textMessageReceived(uint64 serverConnectionHandlerID, anyID fromID, anyID toID, anyID targetMode, QString senderUniqueID, const QString& fromName, QString message, bool outgoing, qint64 received)
 {
 	auto s = getServer(serverConnectionHandlerID);
 	if (s == nullptr)
@@ -416,26 +752,34 @@ void PluginHelper::textMessageReceived(uint64 serverConnectionHandlerID, anyID f
 		return;
 	}
 	auto c = s->getClient(fromID);
+	// the id can belong to someone else by now if its client left where we couldn't see
+	if (c != nullptr && c->uniqueId() != senderUniqueID)
+	{
+		s->clientLeft(fromID);
+		c = nullptr;
+	}
 	if (c == nullptr)
 	{
+		// a client seen before keeps its state, like whether its history was read
 		QSharedPointer<TsClient> client(new TsClient(fromName, senderUniqueID, fromID));
-		c = client;
-		getServer(serverConnectionHandlerID)->addClient(fromID, client);
+		c = s->addClient(fromID, client);
 	}
 	auto r = s->getClient(toID);
 
 	if (targetMode == 1 && !outgoing && config->getConfigAsBool("HISTORY_ENABLED") && !c->historyRead())
 	{
-		QString target = s->safeUniqueId();
-		QJsonObject json
-		{
-			{"type", "privateChatLog"},
-			{"target", target},
-			{"client", c->safeUniqueId()},
-			{"log", LogReader::readPrivateLog(target, c->uniqueId().toLatin1().toBase64())}
-		};
-		emit wObject->sendMessage(json);
-		c->setHistoryRead();
+		requestPrivateHistory(s, c);
+	}
+
+	// private messages are kept with the other party, like TeamSpeak's logs
+	const QSharedPointer<TsClient> partner = outgoing ? r : c;
+	const QString name = targetMode == 3 ? "server" : targetMode == 2 ? "channel"
+		: partner != nullptr ? QString("clients/%1").arg(QString(partner->uniqueId().toLatin1().toBase64())) : QString();
+	if (!name.isEmpty())
+	{
+		QMetaObject::invokeMethod(historyLoader, "storeMessage", Qt::QueuedConnection, Q_ARG(QString, s->safeUniqueId()), Q_ARG(QString, name),
+			Q_ARG(qint64, QDateTime::currentSecsSinceEpoch()), Q_ARG(QString, senderUniqueID), Q_ARG(int, fromID), Q_ARG(bool, outgoing),
+			Q_ARG(QString, fromName), Q_ARG(QString, message));
 	}
 
 	// serverid, in or out, time, name, link, message, mode, senderid, targetid
@@ -452,7 +796,7 @@ void PluginHelper::textMessageReceived(uint64 serverConnectionHandlerID, anyID f
 		{"client", c->safeUniqueId()},
 		{"receiver", r != nullptr ? r->safeUniqueId() : "MISSING-DEFAULT"}
 	};
-	emit wObject->sendMessage(json);
+	wObject->post(json, received);
 }
 
 QString PluginHelper::getServerId(uint64 serverConnectionHandlerID) const
@@ -476,7 +820,7 @@ void PluginHelper::serverConnected(uint64 serverConnectionHandlerID)
 		if (servers.contains(res))
 		{
 			server = servers.value(res);
-			server->setConnected();
+			server->setConnected(serverConnectionHandlerID);
 			server->updateClients();
 			server->updateOwnId();
 			server->updateChannels();
@@ -485,19 +829,15 @@ void PluginHelper::serverConnected(uint64 serverConnectionHandlerID)
 		{
 			server = QSharedPointer<TsServer>(new TsServer(serverConnectionHandlerID, res));
 			emit wObject->addServer(server->safeUniqueId());
-			if (config->getConfigAsBool("HISTORY_ENABLED"))
-			{
-				QString target = server->safeUniqueId();
-				QJsonObject json
-				{
-					{"type", "chatLog"},
-					{"target", target},
-					{"log", LogReader::readLog(target)}
-				};
-				emit wObject->sendMessage(json);
-			}
 			servers.insert(res, server);
 		}
+		syncRoster(server);
+
+		// also retried on reconnect if the previous read was cancelled
+		if (config->getConfigAsBool("HISTORY_ENABLED") && !server->historyRead())
+		{
+			requestServerHistory(server);
+		}
 		
 		free(res);
 
@@ -511,19 +851,12 @@ void PluginHelper::serverConnected(uint64 serverConnectionHandlerID)
 				{"time", utils::time()},
 				{"message", msg}
 			};
-			emit wObject->sendMessage(json);
+			wObject->post(json);
 			free(msg);
 		}
 		if (config->getConfigAsBool("EVENT_SELFCONNECT") && ts3Functions.getServerVariableAsString(serverConnectionHandlerID, VIRTUALSERVER_NAME, &msg) == ERROR_ok)
 		{
-			QJsonObject json
-			{
-				{"type", "serverConnected"},
-				{"target", server->safeUniqueId()},
-				{"time", utils::time()},
-				{"message", msg}
-			};
-			emit wObject->sendMessage(json);
+			postStatus(StatusText::event("serverConnected", server->safeUniqueId(), StatusText::serverConnected(msg)));
 			free(msg);
 		}
 		getServerEmoteFileInfo(serverConnectionHandlerID);
@@ -536,7 +869,7 @@ QSharedPointer<TsServer> PluginHelper::getServer(uint64 serverConnectionHandlerI
 	return servers.value(uid);
 }
 
-void PluginHelper::serverDisconnected(uint serverConnectionHandlerID) const
+void PluginHelper::serverDisconnected(uint serverConnectionHandlerID)
 {
 	auto s = getServer(serverConnectionHandlerID);
 	if (s == nullptr)
@@ -545,6 +878,9 @@ void PluginHelper::serverDisconnected(uint serverConnectionHandlerID) const
 		return;
 	}
 
+	cancelHistory(s->safeUniqueId());
+	QMetaObject::invokeMethod(historyLoader, "unwatch", Qt::QueuedConnection, Q_ARG(QString, s->safeUniqueId()), Q_ARG(QString, QString()));
+
 	// don't spam "disconnected" in case connection was lost
 	if (s->connected())
 	{
@@ -553,17 +889,11 @@ void PluginHelper::serverDisconnected(uint serverConnectionHandlerID) const
 		if (!config->getConfigAsBool("EVENT_SELFDISCONNECT"))
 			return;
 
-		QJsonObject json
-		{
-			{"type", "serverDisconnected"},
-			{"target", s->safeUniqueId()},
-			{"time", utils::time()}
-		};
-		emit wObject->sendMessage(json);
+		postStatus(StatusText::event("serverDisconnected", s->safeUniqueId(), StatusText::serverDisconnected()));
 	}
 }
 
-void PluginHelper::clientConnected(uint64 serverConnectionHandlerID, anyID clientID) const
+void PluginHelper::clientConnected(uint64 serverConnectionHandlerID, anyID clientID)
 {
 	auto s = getServer(serverConnectionHandlerID);
 	if (s == nullptr)
@@ -578,18 +908,10 @@ void PluginHelper::clientConnected(uint64 serverConnectionHandlerID, anyID clien
 	if (!config->getConfigAsBool("EVENT_CLIENTCONNECT"))
 		return;
 
-	QJsonObject json
-	{
-		{"type", "clientConnected"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"link", client->clientLink()},
-		{"name", client->name()}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("clientConnected", s->safeUniqueId(), StatusText::clientConnected(client->clientLink(), client->name())));
 }
 
-void PluginHelper::clientDisconnected(uint64 serverConnectionHandlerID, anyID clientID, QString message) const
+void PluginHelper::clientDisconnected(uint64 serverConnectionHandlerID, anyID clientID, QString message)
 {
 	if (!config->getConfigAsBool("EVENT_CLIENTDISCONNECT"))
 		return;
@@ -612,19 +934,10 @@ void PluginHelper::clientDisconnected(uint64 serverConnectionHandlerID, anyID cl
 		return;
 	}
 
-	QJsonObject json
-	{
-		{"type", "clientDisconnected"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"link", client->clientLink()},
-		{"name", client->name()},
-		{"message", message}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("clientDisconnected", s->safeUniqueId(), StatusText::clientDisconnected(client->clientLink(), client->name(), message)));
 }
 
-void PluginHelper::clientTimeout(uint64 serverConnectionHandlerID, anyID clientID) const
+void PluginHelper::clientTimeout(uint64 serverConnectionHandlerID, anyID clientID)
 {
 	auto s = getServer(serverConnectionHandlerID);
 	if (s == nullptr)
@@ -639,15 +952,7 @@ void PluginHelper::clientTimeout(uint64 serverConnectionHandlerID, anyID clientI
 		return;
 	}
 
-	QJsonObject json
-	{
-		{"type", "clientTimeout"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"link", c->clientLink()},
-		{"name", c->name()}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("clientTimeout", s->safeUniqueId(), StatusText::clientTimeout(c->clientLink(), c->name())));
 }
 
 void PluginHelper::clientKickedFromChannel(uint64 serverConnectionHandlerID, anyID kickedID, anyID kickerID, const QString& kickerName, const QString& kickerUniqueID, const QString& kickMessage)
@@ -665,16 +970,8 @@ void PluginHelper::clientKickedFromChannel(uint64 serverConnectionHandlerID, any
 	
 	if (kickedID == s->myId())
 	{
-		QJsonObject json
-		{
-			{"type", "channelKick"},
-			{"target", s->safeUniqueId()},
-			{"time", utils::time()},
-			{"kickerlink", TsClient::link(kickerID, kickerUniqueID, kickerName)},
-			{"kickername", kickerName},
-			{"message", kickMessage}
-		};
-		emit wObject->sendMessage(json);
+		postStatus(StatusText::event("channelKick", s->safeUniqueId(),
+			StatusText::kicked("channelKick", "", "", TsClient::link(kickerID, kickerUniqueID, kickerName), kickerName, kickMessage)));
 		return;
 	}
 
@@ -685,18 +982,8 @@ void PluginHelper::clientKickedFromChannel(uint64 serverConnectionHandlerID, any
 		return;
 	}
 
-	QJsonObject json
-	{
-		{"type", "channelKick"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"link", c->clientLink()},
-		{"name", c->name()},
-		{"kickerlink", TsClient::link(kickerID, kickerUniqueID, kickerName)},
-		{"kickername", kickerName},
-		{"message", kickMessage}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("channelKick", s->safeUniqueId(),
+		StatusText::kicked("channelKick", c->clientLink(), c->name(), TsClient::link(kickerID, kickerUniqueID, kickerName), kickerName, kickMessage)));
 }
 
 void PluginHelper::clientKickedFromServer(uint64 serverConnectionHandlerID, anyID kickedID, anyID kickerID, const QString& kickerName, const QString& kickerUniqueID, const QString& kickMessage)
@@ -713,16 +1000,8 @@ void PluginHelper::clientKickedFromServer(uint64 serverConnectionHandlerID, anyI
 
 	if (kickedID == s->myId())
 	{
-		QJsonObject json
-		{
-			{"type", "serverKick"},
-			{"target", s->safeUniqueId()},
-			{"time", utils::time()},
-			{"kickerlink", TsClient::link(kickerID, kickerUniqueID, kickerName)},
-			{"kickername", kickerName},
-			{"message", kickMessage}
-		};
-		emit wObject->sendMessage(json);
+		postStatus(StatusText::event("serverKick", s->safeUniqueId(),
+			StatusText::kicked("serverKick", "", "", TsClient::link(kickerID, kickerUniqueID, kickerName), kickerName, kickMessage)));
 		return;
 	}
 
@@ -733,18 +1012,8 @@ void PluginHelper::clientKickedFromServer(uint64 serverConnectionHandlerID, anyI
 		return;
 	}
 
-	QJsonObject json
-	{
-		{"type", "serverKick"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"link", c->clientLink()},
-		{"name", c->name()},
-		{"kickerlink", TsClient::link(kickerID, kickerUniqueID, kickerName)},
-		{"kickername", kickerName},
-		{"message", kickMessage}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("serverKick", s->safeUniqueId(),
+		StatusText::kicked("serverKick", c->clientLink(), c->name(), TsClient::link(kickerID, kickerUniqueID, kickerName), kickerName, kickMessage)));
 }
 
 void PluginHelper::clientBannedFromServer(uint64 serverConnectionHandlerID, anyID bannedID, anyID kickerID, const QString& kickerName, const QString& kickerUniqueID, const QString& kickMessage)
@@ -761,16 +1030,8 @@ void PluginHelper::clientBannedFromServer(uint64 serverConnectionHandlerID, anyI
 
 	if (bannedID == s->myId())
 	{
-		QJsonObject json
-		{
-			{"type", "clientBan"},
-			{"target", s->safeUniqueId()},
-			{"time", utils::time()},
-			{"kickerlink", TsClient::link(kickerID, kickerUniqueID, kickerName)},
-			{"kickername", kickerName},
-			{"message", kickMessage}
-		};
-		emit wObject->sendMessage(json);
+		postStatus(StatusText::event("clientBan", s->safeUniqueId(),
+			StatusText::kicked("clientBan", "", "", TsClient::link(kickerID, kickerUniqueID, kickerName), kickerName, kickMessage)));
 		return;
 	}
 
@@ -781,18 +1042,8 @@ void PluginHelper::clientBannedFromServer(uint64 serverConnectionHandlerID, anyI
 		return;
 	}
 
-	QJsonObject json
-	{
-		{"type", "clientBan"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"link", c->clientLink()},
-		{"name", c->name()},
-		{"kickerlink", TsClient::link(kickerID, kickerUniqueID, kickerName)},
-		{"kickername", kickerName},
-		{"message", kickMessage}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("clientBan", s->safeUniqueId(),
+		StatusText::kicked("clientBan", c->clientLink(), c->name(), TsClient::link(kickerID, kickerUniqueID, kickerName), kickerName, kickMessage)));
 }
 
 void PluginHelper::clientMoveBySelf(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID)
@@ -809,19 +1060,9 @@ void PluginHelper::clientMoveBySelf(uint64 serverConnectionHandlerID, anyID clie
 
 	if (clientID == s->myId())
 	{
-		QJsonObject json
-		{
-			{"type", "clientMoveBySelf"},
-			{"target", s->safeUniqueId()},
-			{"time", utils::time()},
-			{"clientLink", ""},
-			{"clientName", ""},
-			{"oldChannelLink", QString("channelid://%1").arg(oldChannelID)},
-			{"newChannelLink", QString("channelid://%1").arg(newChannelID)},
-			{"oldChannelName", s->getChannelName(oldChannelID)},
-			{"newChannelName", s->getChannelName(newChannelID)}
-		};
-		emit wObject->sendMessage(json);
+		postStatus(StatusText::event("clientMoveBySelf", s->safeUniqueId(),
+			StatusText::movedBySelf("", "", QString("channelid://%1").arg(oldChannelID), s->getChannelName(oldChannelID),
+				QString("channelid://%1").arg(newChannelID), s->getChannelName(newChannelID))));
 
 		return;
 	}
@@ -833,19 +1074,9 @@ void PluginHelper::clientMoveBySelf(uint64 serverConnectionHandlerID, anyID clie
 		return;
 	}
 
-	QJsonObject json
-	{
-		{"type", "clientMoveBySelf"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"clientLink", c->clientLink()},
-		{"clientName", c->name()},
-		{"oldChannelLink", QString("channelid://%1").arg(oldChannelID)},
-		{"newChannelLink", QString("channelid://%1").arg(newChannelID)},
-		{"oldChannelName", s->getChannelName(oldChannelID)},
-		{"newChannelName", s->getChannelName(newChannelID)}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("clientMoveBySelf", s->safeUniqueId(),
+		StatusText::movedBySelf(c->clientLink(), c->name(), QString("channelid://%1").arg(oldChannelID), s->getChannelName(oldChannelID),
+			QString("channelid://%1").arg(newChannelID), s->getChannelName(newChannelID))));
 }
 
 void PluginHelper::clientMovedByOther(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, 
@@ -863,23 +1094,10 @@ void PluginHelper::clientMovedByOther(uint64 serverConnectionHandlerID, anyID cl
 
 	if (clientID == s->myId())
 	{
-		QJsonObject json
-		{
-			{"type", "clientMoveByOther"},
-			{"target", s->safeUniqueId()},
-			{"time", utils::time()},
-			{"clientLink", ""},
-			{"clientName", ""},
-			{"moverLink", TsClient::link(moverID, moverUniqueID, moverName)},
-			{"moverName", moverName},
-			{"oldChannelLink", QString("channelid://%1").arg(oldChannelID)},
-			{"newChannelLink", QString("channelid://%1").arg(newChannelID)},
-			{"oldChannelName", s->getChannelName(oldChannelID)},
-			{"newChannelName", s->getChannelName(newChannelID)},
-			{"moveMessage", moveMessage}
-		};
-
-		emit wObject->sendMessage(json);
+		postStatus(StatusText::event("clientMoveByOther", s->safeUniqueId(),
+			StatusText::movedByOther("", "", TsClient::link(moverID, moverUniqueID, moverName), moverName,
+				QString("channelid://%1").arg(oldChannelID), s->getChannelName(oldChannelID),
+				QString("channelid://%1").arg(newChannelID), s->getChannelName(newChannelID), moveMessage)));
 
 		return;
 	}
@@ -891,22 +1109,10 @@ void PluginHelper::clientMovedByOther(uint64 serverConnectionHandlerID, anyID cl
 		return;
 	}
 
-	QJsonObject json
-	{
-		{"type", "clientMoveByOther"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"clientLink", c->clientLink()},
-		{"clientName", c->name()},
-		{"moverLink", TsClient::link(moverID, moverUniqueID, moverName)},
-		{"moverName", moverName},
-		{"oldChannelLink", QString("channelid://%1").arg(oldChannelID)},
-		{"newChannelLink", QString("channelid://%1").arg(newChannelID)},
-		{"oldChannelName", s->getChannelName(oldChannelID)},
-		{"newChannelName", s->getChannelName(newChannelID)},
-		{"moveMessage", moveMessage}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("clientMoveByOther", s->safeUniqueId(),
+		StatusText::movedByOther(c->clientLink(), c->name(), TsClient::link(moverID, moverUniqueID, moverName), moverName,
+			QString("channelid://%1").arg(oldChannelID), s->getChannelName(oldChannelID),
+			QString("channelid://%1").arg(newChannelID), s->getChannelName(newChannelID), moveMessage)));
 }
 
 void PluginHelper::channelCreated(uint64 serverConnectionHandlerID, uint64 channelID, anyID creatorID, const QString& creatorUniqueID, const QString& creatorName)
@@ -922,17 +1128,9 @@ void PluginHelper::channelCreated(uint64 serverConnectionHandlerID, uint64 chann
 	}
 	bool ownCreation = s->myId() == creatorID;
 
-	QJsonObject json
-	{
-		{"type", "channelCreated"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"channelLink", QString("channelid://%1").arg(channelID)},
-		{"channelName", s->getChannelName(channelID)},
-		{"creatorLink", ownCreation ? "" : TsClient::link(creatorID, creatorUniqueID, creatorName)},
-		{"creatorName", ownCreation ? "" : creatorName}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("channelCreated", s->safeUniqueId(),
+		StatusText::channelCreated(QString("channelid://%1").arg(channelID), s->getChannelName(channelID),
+			ownCreation ? "" : TsClient::link(creatorID, creatorUniqueID, creatorName), ownCreation ? "" : creatorName)));
 }
 
 void PluginHelper::channelDeleted(uint64 serverConnectionHandlerID, uint64 channelID, anyID deleterID, const QString& deleterUniqueID, const QString& deleterName)
@@ -960,17 +1158,8 @@ void PluginHelper::channelDeleted(uint64 serverConnectionHandlerID, uint64 chann
 		}
 	}
 
-	QJsonObject json
-	{
-		{"type", "channelDeleted"},
-		{"target", s->safeUniqueId()},
-		{"time", utils::time()},
-		{"channelLink", QString("channelid://%1").arg(channelID)},
-		{"channelName", s->getChannelName(channelID)},
-		{"deleterLink", deleterLink},
-		{"deleterName", deleterName}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("channelDeleted", s->safeUniqueId(),
+		StatusText::channelDeleted(QString("channelid://%1").arg(channelID), s->getChannelName(channelID), deleterLink, deleterName)));
 }
 
 void PluginHelper::channelEdited(uint64 serverConnectionHandlerID, uint64 channelID, anyID editorID, const QString& editorUniqueID, const QString& editorName)
@@ -1000,12 +1189,19 @@ void PluginHelper::transferStatusChanged(anyID transferID, unsigned int status)
 
 void PluginHelper::clientDisplayNameChanged(uint64 serverConnectionHandlerID, anyID clientID, QString displayName) const
 {
-	auto c = getServer(serverConnectionHandlerID)->getClient(clientID);
+	auto s = getServer(serverConnectionHandlerID);
+	if (s == nullptr)
+	{
+		logError(QString("%1: no cached server").arg(__func__));
+		return;
+	}
+	auto c = s->getClient(clientID);
 	if (c == nullptr)
 	{
 		logError(QString("%1: no cached client").arg(__func__));
+		return;
 	}
-	c->setName(displayName);
+	s->renameClient(c, displayName);
 }
 
 void PluginHelper::poked(uint64 serverConnectionHandlerID, anyID pokerID, const QString& pokerName, QString pokerUniqueID, QString pokeMessage) const
@@ -1033,21 +1229,52 @@ void PluginHelper::poked(uint64 serverConnectionHandlerID, anyID pokerID, const
 		{"name", pokerName},
 		{"message", pokeMessage}
 	};
-	emit wObject->sendMessage(json);
+	wObject->post(json);
 }
 
+// the page is rebuilt from the replay buffer
 void PluginHelper::reload() const
 {
 	chat->reload();
 }
 
-void PluginHelper::onReloaded() const
+// reload with nothing to replay, history is read again
+void PluginHelper::clearChat()
+{
+	wObject->clearReplay();
+	for (const QSharedPointer<TsServer>& s : servers)
+	{
+		cancelHistory(s->safeUniqueId());
+		s->resetHistoryRead();
+	}
+	chat->reload();
+}
+
+// page loaded for the first time or again after a reload
+void PluginHelper::onPageReady()
 {
 	int mode;
 	QString server;
 	QSharedPointer<TsClient> client;
 	std::tie(mode, server, client) = getCurrentTab();
 	wObject->loadEmotes();
+
+	// history already sent is part of the replay, only what was cleared is read again
+	if (config->getConfigAsBool("HISTORY_ENABLED"))
+	{
+		for (const QSharedPointer<TsServer>& s : servers)
+		{
+			if (s->connected() && !s->historyRead())
+			{
+				requestServerHistory(s);
+			}
+		}
+		if (client != nullptr && !client->historyRead())
+		{
+			requestPrivateHistory(getServer(ts3Functions.getCurrentServerConnectionHandlerID()), client);
+		}
+	}
+
 	wObject->tabChanged(server, mode, client ? client->safeUniqueId() : "");
 }
 
@@ -1082,26 +1309,61 @@ void PluginHelper::openTransfers() const
 	transfers->show();
 }
 
+void PluginHelper::unpinTab(QWidget* tab) const
+{
+	auto known = tabClients.constFind(tab);
+	if (known == tabClients.constEnd())
+		return;
+
+	auto s = servers.value(known->first);
+	const quint32 handle = UidPool::instance().find(known->second);
+	if (s != nullptr && handle != UidPool::invalid)
+	{
+		s->unpin(handle);
+	}
+	tabClients.remove(tab);
+}
+
+// runs on the history thread, results are printed as they come
+void PluginHelper::runBenchmark() const
+{
+	const QString target = getServerId(ts3Functions.getCurrentServerConnectionHandlerID());
+	QMetaObject::invokeMethod(historyLoader, "benchmark", Qt::QueuedConnection, Q_ARG(QString, target));
+}
+
+// "/lxb stats" in the chat
+void PluginHelper::printStats() const
+{
+	onPrintConsoleMessageToCurrentTab(MessageStore::cacheStats());
+	for (const QSharedPointer<TsServer>& s : servers)
+	{
+		onPrintConsoleMessageToCurrentTab(s->clientStats());
+	}
+	onPrintConsoleMessageToCurrentTab(QString("Unique ids: %1 in use").arg(UidPool::instance().size()));
+	onPrintConsoleMessageToCurrentTab(wObject->wireStats());
+	onPrintConsoleMessageToCurrentTab(wObject->wireComparison());
+	onPrintConsoleMessageToCurrentTab(wObject->replayStats());
+	for (const QString& line : wObject->latencyStats())
+	{
+		onPrintConsoleMessageToCurrentTab(line);
+	}
+}
+
 void PluginHelper::onConfigChanged() const
 {
 	QString dir = config->getConfigAsString("DOWNLOAD_DIR");
 	transfers->setDownloadDirectory(dir);
+	wObject->setBatchInterval(config->getConfigAsInt("BATCH_INTERVAL", 16));
+	wObject->setReplayLines(config->getConfigAsInt("MAX_LINES", 500));
 }
 
-void PluginHelper::serverStopped(uint64 serverConnectionHandlerID, const QString& message) const
+void PluginHelper::serverStopped(uint64 serverConnectionHandlerID, const QString& message)
 {
-	QJsonObject json
-	{
-		{"type", "serverStopped"},
-		{"target", getServerId(serverConnectionHandlerID)},
-		{"time", utils::time()},
-		{"message", message}
-	};
-	emit wObject->sendMessage(json);
+	postStatus(StatusText::event("serverStopped", getServerId(serverConnectionHandlerID), StatusText::serverStopped(message)));
 }
 
 // called when client enters view by joining the same channel or by this client subscribing to a channel
-void PluginHelper::clientEnteredView(uint64 serverConnectionHandlerID, anyID clientID) const
+void PluginHelper::clientEnteredView(uint64 serverConnectionHandlerID, anyID clientID)
 {
 	auto s = getServer(serverConnectionHandlerID);
 	if (s == nullptr) 
@@ -1111,5 +1373,42 @@ void PluginHelper::clientEnteredView(uint64 serverConnectionHandlerID, anyID cli
 		return;
 	}
 
-	s->addClient(clientID);
+	// read when it is first needed, a channel full of clients entering at once costs nothing
+	const bool idle = !s->rosterPending();
+	s->clientEntered(clientID);
+	if (idle)
+	{
+		syncRoster(s);
+	}
+}
+
+// left the server
+void PluginHelper::clientLeftView(uint64 serverConnectionHandlerID, anyID clientID) const
+{
+	auto s = getServer(serverConnectionHandlerID);
+	if (s == nullptr)
+		return;
+
+	s->clientLeft(clientID);
+}
+
+// moved somewhere we can't see or we stopped subscribing to its channel
+void PluginHelper::clientHiddenFromView(uint64 serverConnectionHandlerID, anyID clientID) const
+{
+	auto s = getServer(serverConnectionHandlerID);
+	if (s == nullptr)
+		return;
+
+	s->clientHidden(clientID);
+}
+
+// clients are read a few ms at a time so a big server doesn't freeze the ui
+void PluginHelper::syncRoster(const QSharedPointer<TsServer>& server)
+{
+	QTimer::singleShot(0, this, [=]() {
+		if (server->syncRoster(rosterSlice))
+		{
+			syncRoster(server);
+		}
+	});
 }
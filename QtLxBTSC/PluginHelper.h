@@ -13,6 +13,9 @@
 #include "ConfigWidget.h"
 #include "FileTransferListWidget.h"
 #include "TsServer.h"
+#include "HistoryLoader.h"
+#include <QThread>
+#include <QHash>
 
 class PluginHelper : public QObject
 {
@@ -23,27 +26,32 @@ public:
 	~PluginHelper();
 
 	void textMessageReceived(uint64 serverConnectionHandlerID, anyID fromID, anyID toID, anyID targetMode, QString senderUniqueID,
-	                         const QString& fromName, QString message, bool outgoing) const;
+	                         const QString& fromName, QString message, bool outgoing, qint64 received = 0);
 	void serverConnected(uint64 serverConnectionHandlerID);
-	void serverDisconnected(uint serverConnectionHandlerID) const;
-	void clientConnected(uint64 serverConnectionHandlerID, anyID clientID) const;
-	void clientDisconnected(uint64 serverConnectionHandlerID, anyID clientID, QString message) const;
-	void clientEnteredView(uint64 serverConnectionHandlerID, anyID clientID) const;
+	void serverDisconnected(uint serverConnectionHandlerID);
+	void clientConnected(uint64 serverConnectionHandlerID, anyID clientID);
+	void clientDisconnected(uint64 serverConnectionHandlerID, anyID clientID, QString message);
+	void clientEnteredView(uint64 serverConnectionHandlerID, anyID clientID);
+	void clientLeftView(uint64 serverConnectionHandlerID, anyID clientID) const;
+	void clientHiddenFromView(uint64 serverConnectionHandlerID, anyID clientID) const;
 	//void clientEnteredViewBySubscription(uint64 serverConnectionHandlerID, anyID clientID);
-	void clientTimeout(uint64 serverConnectionHandlerID, anyID clientID) const;
+	void clientTimeout(uint64 serverConnectionHandlerID, anyID clientID);
 	void clientDisplayNameChanged(uint64 serverConnectionHandlerID, anyID clientID, QString displayName) const;
 	void poked(uint64 serverConnectionHandlerID, anyID pokerID, const QString& pokerName, QString pokerUniqueID, QString pokeMessage) const;
 	void transferStatusChanged(anyID transferID, unsigned int status);
 	void toggleNormalChat() const;
 	void reload() const;
+	void clearChat();
 	void reloadEmotes() const;
 	void fullReloadEmotes();
 	void openConfig() const;
 	void openTransfers() const;
+	void printStats() const;
+	void runBenchmark() const;
 
 	void handleFileInfoEvent(uint64 serverConnectionHandlerID, uint64 channelID, const QString& name, uint64 size, uint64 datetime);
 
-	void serverStopped(uint64 serverConnectionHandlerID, const QString& message) const;
+	void serverStopped(uint64 serverConnectionHandlerID, const QString& message);
 
 	void clientKickedFromChannel(uint64 serverConnectionHandlerID, anyID kickedID, anyID kickerID, const QString& kickerName, const QString& kickerUniqueID, const QString& kickMessage);
 	void clientKickedFromServer(uint64 serverConnectionHandlerID, anyID kickedID, anyID kickerID, const QString& kickerName, const QString& kickerUniqueID, const QString& kickMessage);
@@ -62,7 +70,8 @@ signals:
 private slots:
 	void onEmoticonAppend(const QString& e) const;
 	void onEmoticonButtonClicked(bool c) const;
-	void onTabChange(int i) const;
+	void onTabChange(int i);
+	void onTabCloseRequested(int i);
 	void onTransferFailure() const;
 	void onClientUrlClicked(const QUrl &url) const;
 	void onChannelUrlClicked(const QUrl &url) const;
@@ -70,7 +79,14 @@ private slots:
 	void onPrintConsoleMessageToCurrentTab(const QString& message) const;
 	void onPrintConsoleMessage(uint64 serverConnectionHandlerID, QString message, int targetMode) const;
 	void onConfigChanged() const;
-	void onReloaded() const;
+	void onPageReady();
+	void onApplicationStateChanged(Qt::ApplicationState state);
+	void onLogRead(quint64 requestId, const QString& target, const QJsonObject& log);
+	void onPrivateLogRead(quint64 requestId, const QString& target, const QString& client, const QJsonArray& log);
+	void onHistoryPageRequested(const QString& target, int mode, const QString& client, qint64 before, int count);
+	void onPageRead(quint64 requestId, const QString& target, int mode, const QString& client, const QJsonArray& log);
+	void onHistorySearchRequested(const QString& text, const QString& target, int mode, const QString& sender, qint64 from, qint64 to, int limit);
+	void onSearchDone(quint64 requestId, const QString& text, const QJsonArray& results, bool complete);
 
 private:
 	QMainWindow* mainwindow;
@@ -89,6 +105,28 @@ private:
 	const QString pluginPath;
 	Qt::ApplicationState currentState;
 	QList<anyID> downloads;
+	// private chat tab -> server and client unique id, tab texts follow nickname changes
+	mutable QHash<QWidget*, QPair<QString, QString>> tabClients;
+
+	struct PendingHistory
+	{
+		quint64 requestId;
+		QSharedPointer<TsServer> server;
+		QSharedPointer<TsClient> client;
+	};
+	QThread historyThread;
+	HistoryLoader* historyLoader;
+	QMap<QString, PendingHistory> pendingHistory;
+	quint64 lastHistoryRequest;
+	quint64 pendingSearch;
+
+	// status events of one type on one server while a burst lasts
+	struct StatusBurst
+	{
+		int shown;
+		QJsonArray held;
+	};
+	QHash<QString, StatusBurst> statusBursts;
 
 	void initUi();
 	void insertMenu();
@@ -102,4 +140,17 @@ private:
 	void requestServerEmoteJson(uint64 serverConnectionHandlerID, uint64 channelID, const QString& filePath);
 
 	QSharedPointer<TsServer> getServer(uint64 serverConnectionHandlerID) const;
+
+	void requestServerHistory(const QSharedPointer<TsServer>& server);
+	void requestPrivateHistory(const QSharedPointer<TsServer>& server, const QSharedPointer<TsClient>& client);
+	void cancelHistory(const QString& target, const QString& client = QString());
+	void updateUnread() const;
+	void unpinTab(QWidget* tab) const;
+	void postStatus(const QJsonObject& json);
+	void endStatusBurst(const QString& key);
+	void flushStatusBursts(const QString& target, const QString& except);
+	void postHeld(StatusBurst& burst);
+	void syncRoster(const QSharedPointer<TsServer>& server);
+
+	const static int rosterSlice = 4;
 };
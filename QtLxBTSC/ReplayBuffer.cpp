@@ -0,0 +1,132 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "ReplayBuffer.h"
+
+ReplayBuffer::ReplayBuffer(int lines)
+	: maxLines(qMax(1, lines))
+{
+}
+
+void ReplayBuffer::setCapacity(int lines)
+{
+	maxLines = qMax(1, lines);
+	for (auto it = tabs.begin(); it != tabs.end(); ++it)
+	{
+		it->setCapacity(maxLines);
+	}
+}
+
+QJsonObject ReplayBuffer::record(const QJsonObject& message)
+{
+	const QString log = logKey(message);
+	if (!log.isEmpty())
+	{
+		logs.insert(log, message);
+		return message;
+	}
+
+	const QString tab = tabKey(message);
+	if (tab.isEmpty())
+		return message;
+
+	auto it = tabs.find(tab);
+	if (it == tabs.end())
+	{
+		it = tabs.insert(tab, QContiguousCache<QJsonObject>(maxLines));
+	}
+	// indexes keep counting when old events fall out
+	QJsonObject stamped = message;
+	stamped.insert("seq", it->lastIndex() + 1);
+	it->append(stamped);
+	return stamped;
+}
+
+bool ReplayBuffer::recorded(const QJsonObject& message)
+{
+	return !logKey(message).isEmpty() || !tabKey(message).isEmpty();
+}
+
+QList<QJsonObject> ReplayBuffer::events(int perTab) const
+{
+	QList<QJsonObject> list = logs.values();
+	for (const QContiguousCache<QJsonObject>& tab : tabs)
+	{
+		for (int i = qMax(tab.firstIndex(), tab.lastIndex() - perTab + 1); i <= tab.lastIndex(); ++i)
+		{
+			list.append(tab.at(i));
+		}
+	}
+	return list;
+}
+
+QList<QJsonObject> ReplayBuffer::range(const QString& tab, int before, int count) const
+{
+	QList<QJsonObject> list;
+	auto it = tabs.constFind(tab);
+	if (it == tabs.constEnd() || it->isEmpty())
+		return list;
+
+	const int end = qMin(before, it->lastIndex() + 1);
+	for (int i = qMax(it->firstIndex(), end - count); i < end; ++i)
+	{
+		list.append(it->at(i));
+	}
+	return list;
+}
+
+void ReplayBuffer::clear()
+{
+	logs.clear();
+	tabs.clear();
+}
+
+QString ReplayBuffer::stats() const
+{
+	int count = 0;
+	for (const QContiguousCache<QJsonObject>& tab : tabs)
+	{
+		count += tab.count();
+	}
+	return QString("Replay: %1 events in %2 tabs, %3 history logs").arg(count).arg(tabs.size()).arg(logs.size());
+}
+
+QString ReplayBuffer::tabKey(const QJsonObject& message)
+{
+	const QString type = message.value("type").toString();
+	const QString target = message.value("target").toString();
+	if (target.isEmpty() || type == "historyPage" || type == "consoleMessageToCurrentTab")
+		return QString();
+
+	if (type == "textMessage")
+	{
+		const bool outgoing = message.value("direction").toString() == "Outgoing";
+		return tabKey(target, message.value("mode").toInt(), message.value(outgoing ? "receiver" : "client").toString());
+	}
+	if (type == "consoleMessage")
+	{
+		return tabKey(target, message.value("mode").toInt(), message.value("client").toString());
+	}
+	return tabKey(target, 3, QString());
+}
+
+// only private tabs are told apart by client
+QString ReplayBuffer::tabKey(const QString& target, int mode, const QString& client)
+{
+	return QString("%1/%2/%3").arg(target, QString::number(mode), mode == 1 ? client : QString());
+}
+
+// only the newest history of a tab is kept
+QString ReplayBuffer::logKey(const QJsonObject& message)
+{
+	const QString type = message.value("type").toString();
+	if (type == "chatLog")
+		return message.value("target").toString();
+	if (type == "privateChatLog")
+		return QString("%1/1/%2").arg(message.value("target").toString(), message.value("client").toString());
+	return QString();
+}
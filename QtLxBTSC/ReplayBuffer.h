@@ -0,0 +1,48 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QContiguousCache>
+#include <QHash>
+#include <QJsonObject>
+#include <QList>
+
+// the last events of every tab, so a reloaded page can be rebuilt without asking anyone
+// and the page only needs to keep what is on screen, history logs are kept aside and
+// don't count against the lines of their tab
+//
+// tab events get a "seq" that grows by one per event of the tab, the page asks for ranges by it
+class ReplayBuffer
+{
+public:
+	ReplayBuffer(int lines = 500);
+
+	// same as the lines the page keeps per tab
+	void setCapacity(int lines);
+	// the message as it is kept, with its seq if it belongs to a tab
+	QJsonObject record(const QJsonObject& message);
+	// true for events that belong to a tab and are kept
+	static bool recorded(const QJsonObject& message);
+	// history first, then at most the last perTab events of each tab oldest first
+	QList<QJsonObject> events(int perTab) const;
+	// up to count events of a tab before seq, oldest first
+	QList<QJsonObject> range(const QString& tab, int before, int count) const;
+	void clear();
+	QString stats() const;
+
+	// "target/mode/client" of the tab the page puts an event in, empty for events that are not part of a tab
+	static QString tabKey(const QJsonObject& message);
+	static QString tabKey(const QString& target, int mode, const QString& client);
+
+private:
+	int maxLines;
+	QHash<QString, QJsonObject> logs;
+	QHash<QString, QContiguousCache<QJsonObject>> tabs;
+
+	static QString logKey(const QJsonObject& message);
+};
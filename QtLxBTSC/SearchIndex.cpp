@@ -0,0 +1,465 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "SearchIndex.h"
+#include "LogReader.h"
+#include "LogIndex.h"
+#include "LogScanner.h"
+#include "globals.h"
+#include "utils.h"
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QDateTime>
+#include <algorithm>
+#include <iterator>
+
+SearchIndex::SearchIndex()
+	: removedCount(0)
+{
+}
+
+SearchIndex::~SearchIndex()
+{
+}
+
+bool SearchIndex::refresh()
+{
+	// chats/<server>/{server,channel}.html and chats/<server>/clients/<client>.html
+	QDir chats(QString("%1chats").arg(configPath));
+	for (const QString& target : chats.entryList(QDir::Dirs | QDir::NoDotAndDotDot))
+	{
+		addLog(target, "server", 3, QString());
+		addLog(target, "channel", 2, QString());
+		QDir clients(chats.filePath(QString("%1/clients").arg(target)));
+		for (const QString& file : clients.entryList({ "*.html" }, QDir::Files))
+		{
+			const QString fileName = QFileInfo(file).completeBaseName();
+			const QString client = utils::ts3WeirdBase16(QString::fromLatin1(QByteArray::fromBase64(fileName.toLatin1())));
+			addLog(target, QString("clients/%1").arg(fileName), 1, client);
+		}
+	}
+
+	// only a stat per log, files are not opened unless they changed
+	for (int id = 0; id < logs.size(); ++id)
+	{
+		const Log& log = logs.at(id);
+		const QFileInfo info(LogReader::logPath(log.target, log.name));
+		const qint64 size = info.exists() ? info.size() : 0;
+		const qint64 modified = info.exists() ? info.lastModified().toMSecsSinceEpoch() : 0;
+		if ((size != log.size || modified != log.modified) && !stale.contains(id))
+		{
+			stale.append(id);
+		}
+	}
+	return !stale.isEmpty();
+}
+
+bool SearchIndex::indexNext()
+{
+	if (!stale.isEmpty())
+	{
+		indexLog(stale.takeFirst());
+	}
+	if (removedCount > messages.size() / 2)
+	{
+		compact();
+	}
+	return !stale.isEmpty();
+}
+
+bool SearchIndex::isComplete() const
+{
+	return stale.isEmpty();
+}
+
+const SearchIndex::Log& SearchIndex::log(int id) const
+{
+	return logs.at(id);
+}
+
+void SearchIndex::addLog(const QString& target, const QString& name, int mode, const QString& client)
+{
+	const QString key = QString("%1/%2").arg(target, name);
+	if (logIds.contains(key))
+		return;
+
+	logIds.insert(key, logs.size());
+	logs.append({ target, name, mode, client, 0, 0, 0, false });
+}
+
+void SearchIndex::indexLog(int id)
+{
+	Log& log = logs[id];
+	const QString filePath = LogReader::logPath(log.target, log.name);
+	QFile file(filePath);
+	if (!file.open(QIODevice::ReadOnly) || file.size() == 0)
+	{
+		// deleted or emptied
+		removeMessages(id);
+		QFile::remove(termsPath(log));
+		log.size = 0;
+		log.modified = 0;
+		log.indexed = 0;
+		log.loaded = true;
+		return;
+	}
+
+	const qint64 size = file.size();
+	const qint64 modified = QFileInfo(filePath).lastModified().toMSecsSinceEpoch();
+	uchar* mapped = file.map(0, size);
+	if (mapped == nullptr)
+	{
+		logInfo("SearchIndex: failed to map file");
+		return;
+	}
+
+	// the log index already knows where every message is, reuse it instead of scanning the file again
+	const char* data = reinterpret_cast<const char*>(mapped);
+	LogIndex index(LogReader::indexPath(log.target, log.name));
+	if (!index.update(filePath, data, size))
+	{
+		file.unmap(mapped);
+		return;
+	}
+
+	if (!log.loaded)
+	{
+		log.loaded = true;
+		loadTerms(id, index);
+	}
+	else if (size < log.size || (size == log.size && modified != log.modified) || index.count() < log.indexed)
+	{
+		removeMessages(id);
+		log.indexed = 0;
+	}
+
+	// one message per log index entry, so ids in the terms file are entry positions
+	const int from = log.indexed;
+	const QVector<LogIndex::Entry> entries = index.entries(from, index.count());
+	QHash<QString, QVector<quint32>> added;
+	for (int i = 0; i < entries.size(); ++i)
+	{
+		const LogIndex::Entry& entry = entries.at(i);
+		const quint32 messageId = static_cast<quint32>(messages.size());
+		messages.append({ static_cast<quint32>(id), entry.length, entry.offset, entry.timestamp, entry.uid });
+		removed.append(false);
+
+		const char* begin = data + entry.offset;
+		LogLine line;
+		if (!LogScanner::scan(begin, begin + entry.length, line))
+			continue;
+
+		QStringList terms = tokenize(QString::fromUtf8(line.text), true);
+		std::sort(terms.begin(), terms.end());
+		terms.erase(std::unique(terms.begin(), terms.end()), terms.end());
+		for (const QString& term : terms)
+		{
+			postings[term].append(messageId);
+			added[term].append(static_cast<quint32>(from + i));
+		}
+	}
+	file.unmap(mapped);
+
+	if (!entries.isEmpty())
+	{
+		writeTerms(log, from, from + entries.size(), added, entries.last().offset);
+	}
+	log.indexed = from + entries.size();
+	log.size = size;
+	log.modified = modified;
+}
+
+QString SearchIndex::termsPath(const Log& log)
+{
+	QString path = LogReader::indexPath(log.target, log.name);
+	path.chop(4);
+	return path + ".trm";
+}
+
+// postings an earlier session wrote, only trusted if the log index still has the same messages
+void SearchIndex::loadTerms(int id, LogIndex& index)
+{
+	Log& log = logs[id];
+	QFile file(termsPath(log));
+	if (!file.open(QIODevice::ReadOnly) || file.size() < termsHeaderSize)
+		return;
+
+	QDataStream stream(&file);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	quint32 fileMagic, fileVersion, indexed;
+	quint64 lastOffset, length;
+	stream >> fileMagic >> fileVersion >> indexed >> lastOffset >> length;
+	if (fileMagic != termsMagic || fileVersion != termsVersion || indexed == 0 || indexed > static_cast<quint32>(index.count())
+		|| length > static_cast<quint64>(file.size()))
+		return;
+
+	const QVector<LogIndex::Entry> entries = index.entries(0, static_cast<int>(indexed));
+	if (entries.size() != static_cast<int>(indexed) || entries.last().offset != lastOffset)
+		return;
+
+	QHash<QString, QVector<quint32>> terms;
+	int segments = 0;
+	while (static_cast<quint64>(file.pos()) < length && stream.status() == QDataStream::Ok)
+	{
+		quint32 termCount;
+		stream >> termCount;
+		for (quint32 t = 0; t < termCount && stream.status() == QDataStream::Ok; ++t)
+		{
+			QByteArray term;
+			quint32 count;
+			stream >> term >> count;
+			QVector<quint32>& ids = terms[QString::fromUtf8(term)];
+			for (quint32 i = 0; i < count && stream.status() == QDataStream::Ok; ++i)
+			{
+				quint32 local;
+				stream >> local;
+				if (local < indexed)
+				{
+					ids.append(local);
+				}
+			}
+		}
+		++segments;
+	}
+	if (stream.status() != QDataStream::Ok)
+		return;
+
+	const quint32 base = static_cast<quint32>(messages.size());
+	for (const LogIndex::Entry& entry : entries)
+	{
+		messages.append({ static_cast<quint32>(id), entry.length, entry.offset, entry.timestamp, entry.uid });
+		removed.append(false);
+	}
+	for (auto it = terms.constBegin(); it != terms.constEnd(); ++it)
+	{
+		QVector<quint32>& ids = postings[it.key()];
+		for (quint32 local : it.value())
+		{
+			ids.append(base + local);
+		}
+	}
+	log.indexed = static_cast<int>(indexed);
+
+	// many small passes, write them back as one
+	if (segments > maxSegments)
+	{
+		file.close();
+		writeTerms(log, 0, static_cast<int>(indexed), terms, lastOffset);
+	}
+}
+
+// appends one segment, from is the number of messages the file already has
+void SearchIndex::writeTerms(const Log& log, int from, int indexed, const QHash<QString, QVector<quint32>>& terms, quint64 lastOffset)
+{
+	QFile file(termsPath(log));
+	QDir().mkpath(QFileInfo(file.fileName()).absolutePath());
+	if (!file.open(QIODevice::ReadWrite))
+		return;
+
+	QDataStream stream(&file);
+	stream.setByteOrder(QDataStream::LittleEndian);
+	quint64 length = termsHeaderSize;
+	if (from > 0)
+	{
+		quint32 fileMagic = 0, fileVersion = 0, fileIndexed = 0;
+		quint64 fileLastOffset;
+		if (file.size() >= termsHeaderSize)
+		{
+			stream >> fileMagic >> fileVersion >> fileIndexed >> fileLastOffset >> length;
+		}
+		// the file has to end where this pass starts, otherwise the log is indexed again next session
+		if (fileMagic != termsMagic || fileVersion != termsVersion || fileIndexed != static_cast<quint32>(from)
+			|| length > static_cast<quint64>(file.size()))
+		{
+			file.resize(0);
+			file.seek(0);
+			stream << termsMagic << termsVersion << quint32(0) << quint64(0) << quint64(termsHeaderSize);
+			return;
+		}
+	}
+
+	// anything past the valid length is a pass that was cut short
+	file.resize(static_cast<qint64>(length));
+	file.seek(static_cast<qint64>(length));
+	stream << static_cast<quint32>(terms.size());
+	for (auto it = terms.constBegin(); it != terms.constEnd(); ++it)
+	{
+		stream << it.key().toUtf8() << static_cast<quint32>(it.value().size());
+		for (quint32 local : it.value())
+		{
+			stream << local;
+		}
+	}
+	length = static_cast<quint64>(file.pos());
+
+	file.seek(0);
+	stream << termsMagic << termsVersion << static_cast<quint32>(indexed) << lastOffset << length;
+}
+
+void SearchIndex::removeMessages(int id)
+{
+	if (logs.at(id).indexed == 0)
+		return;
+
+	for (int i = 0; i < messages.size(); ++i)
+	{
+		if (messages.at(i).log == static_cast<quint32>(id) && !removed.at(i))
+		{
+			removed[i] = true;
+			++removedCount;
+		}
+	}
+}
+
+// drop removed messages and renumber the rest, postings stay sorted
+void SearchIndex::compact()
+{
+	QVector<quint32> newIds(messages.size());
+	QVector<Message> kept;
+	kept.reserve(messages.size() - removedCount);
+	for (int i = 0; i < messages.size(); ++i)
+	{
+		newIds[i] = static_cast<quint32>(kept.size());
+		if (!removed.at(i))
+		{
+			kept.append(messages.at(i));
+		}
+	}
+
+	for (auto it = postings.begin(); it != postings.end();)
+	{
+		QVector<quint32> ids;
+		for (quint32 messageId : it.value())
+		{
+			if (!removed.at(messageId))
+			{
+				ids.append(newIds.at(messageId));
+			}
+		}
+		if (ids.isEmpty())
+		{
+			it = postings.erase(it);
+		}
+		else
+		{
+			it.value() = ids;
+			++it;
+		}
+	}
+
+	messages = kept;
+	removed.fill(false, messages.size());
+	removedCount = 0;
+}
+
+QVector<SearchIndex::Hit> SearchIndex::search(const Query& query) const
+{
+	QVector<Hit> hits;
+	if (query.terms.isEmpty() || query.limit <= 0)
+		return hits;
+
+	// intersect starting from the rarest term
+	QVector<const QVector<quint32>*> lists;
+	for (const QString& term : query.terms)
+	{
+		auto it = postings.constFind(term);
+		if (it == postings.constEnd())
+			return hits;
+		lists.append(&it.value());
+	}
+	std::sort(lists.begin(), lists.end(), [](const QVector<quint32>* a, const QVector<quint32>* b) { return a->size() < b->size(); });
+
+	QVector<quint32> candidates = *lists.first();
+	for (int i = 1; i < lists.size() && !candidates.isEmpty(); ++i)
+	{
+		candidates = intersect(candidates, *lists.at(i));
+	}
+
+	for (quint32 messageId : candidates)
+	{
+		if (removed.at(messageId))
+			continue;
+
+		const Message& message = messages.at(messageId);
+		const Log& log = logs.at(message.log);
+		if (!query.target.isEmpty() && log.target != query.target)
+			continue;
+		if (query.mode != 0 && log.mode != query.mode)
+			continue;
+		// logged ids are cut to the index record size
+		if (!query.uid.isEmpty() && (message.uid.isEmpty() || !query.uid.startsWith(message.uid)))
+			continue;
+		// 0 is a time that couldn't be read, those are kept
+		if (query.from > 0 && message.timestamp > 0 && message.timestamp < query.from)
+			continue;
+		if (query.to > 0 && message.timestamp > 0 && message.timestamp > query.to)
+			continue;
+
+		hits.append({ static_cast<int>(message.log), message.offset, message.length, message.timestamp, message.uid });
+	}
+
+	const int count = qMin(query.limit, hits.size());
+	std::partial_sort(hits.begin(), hits.begin() + count, hits.end(), [](const Hit& a, const Hit& b) { return a.timestamp > b.timestamp; });
+	hits.resize(count);
+	return hits;
+}
+
+QVector<quint32> SearchIndex::intersect(const QVector<quint32>& a, const QVector<quint32>& b)
+{
+	QVector<quint32> result;
+	std::set_intersection(a.constBegin(), a.constEnd(), b.constBegin(), b.constEnd(), std::back_inserter(result));
+	return result;
+}
+
+QStringList SearchIndex::tokenize(const QString& text, bool markup)
+{
+	QStringList terms;
+	QString term;
+	auto flush = [&]()
+	{
+		if (!term.isEmpty())
+		{
+			terms.append(term.toCaseFolded());
+			term.clear();
+		}
+	};
+
+	for (int i = 0; i < text.size(); ++i)
+	{
+		const QChar c = text.at(i);
+		if (markup && c == '<')
+		{
+			// skip the whole tag
+			flush();
+			const int close = text.indexOf('>', i);
+			if (close < 0)
+				break;
+			i = close;
+		}
+		else if (markup && c == '&')
+		{
+			// entities separate words, &amp; &#39; etc.
+			flush();
+			const int semicolon = text.indexOf(';', i);
+			if (semicolon > i && semicolon - i <= 8)
+			{
+				i = semicolon;
+			}
+		}
+		else if (c.isLetterOrNumber())
+		{
+			term.append(c);
+		}
+		else
+		{
+			flush();
+		}
+	}
+	flush();
+	return terms;
+}
@@ -0,0 +1,108 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QStringList>
+#include <QVector>
+
+class LogIndex;
+
+// inverted index over every chat log, terms map to sorted lists of message ids,
+// logs are indexed one at a time so the history thread stays responsive while building
+//
+// the postings of each log are kept on disk next to its LogIndex, a later session loads
+// them instead of reading the log again and only indexes what was appended since
+//
+// terms file: header, then one segment per indexing pass
+//   header:  "LXBT", version, indexed messages, offset of the last one, valid length
+//   segment: term count, then per term: utf8 term, id count, ids (positions in the LogIndex)
+class SearchIndex
+{
+public:
+	struct Log
+	{
+		QString target;
+		QString name;
+		int mode;
+		QString client;
+		qint64 size;
+		qint64 modified;
+		int indexed;
+		bool loaded;      // terms file was read this session
+	};
+
+	struct Query
+	{
+		QStringList terms;
+		QString target;   // empty for every server
+		int mode;         // 0 for every tab type
+		QByteArray uid;   // empty for every sender
+		qint64 from;      // seconds since epoch, 0 for no limit
+		qint64 to;
+		int limit;
+	};
+
+	struct Hit
+	{
+		int log;
+		quint64 offset;
+		quint32 length;
+		qint64 timestamp;
+		QByteArray uid;   // cut to the log index record size
+	};
+
+	SearchIndex();
+	~SearchIndex();
+
+	// look for new, grown or rewritten logs, returns true if any need indexing
+	bool refresh();
+	// index the next stale log, returns true if more are left
+	bool indexNext();
+	bool isComplete() const;
+	// newest matches first
+	QVector<Hit> search(const Query& query) const;
+	const Log& log(int id) const;
+
+	// case folded words, markup and entities of logged text are skipped
+	static QStringList tokenize(const QString& text, bool markup);
+
+private:
+	struct Message
+	{
+		quint32 log;
+		quint32 length;
+		quint64 offset;
+		qint64 timestamp;
+		QByteArray uid;
+	};
+
+	QVector<Log> logs;
+	QHash<QString, int> logIds;
+	QVector<int> stale;
+	QVector<Message> messages;
+	// messages of rewritten logs, skipped until their ids are gone from the postings
+	QVector<bool> removed;
+	int removedCount;
+	QHash<QString, QVector<quint32>> postings;
+
+	const static quint32 termsMagic = 0x5442584c; // LXBT
+	const static quint32 termsVersion = 1;
+	const static int termsHeaderSize = 28;
+	// segments are merged into one when a file is loaded with more than this
+	const static int maxSegments = 32;
+
+	void addLog(const QString& target, const QString& name, int mode, const QString& client);
+	void indexLog(int id);
+	void loadTerms(int id, LogIndex& index);
+	void writeTerms(const Log& log, int from, int indexed, const QHash<QString, QVector<quint32>>& terms, quint64 lastOffset);
+	static QString termsPath(const Log& log);
+	void removeMessages(int id);
+	void compact();
+	static QVector<quint32> intersect(const QVector<quint32>& a, const QVector<quint32>& b);
+};
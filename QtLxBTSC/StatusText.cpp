@@ -0,0 +1,138 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "StatusText.h"
+#include "utils.h"
+#include <QHash>
+
+QJsonObject StatusText::event(const QString& kind, const QString& target, const QString& text)
+{
+	return QJsonObject
+	{
+		{"type", "status"},
+		{"target", target},
+		{"time", utils::time()},
+		{"kind", kind},
+		{"style", style(kind)},
+		{"text", text}
+	};
+}
+
+QString StatusText::style(const QString& kind)
+{
+	static const QHash<QString, QString> styles
+	{
+		{ "serverConnected", "TextMessage_Connected" },
+		{ "serverDisconnected", "TextMessage_Disconnected" },
+		{ "serverStopped", "TextMessage_ServerError" },
+		{ "clientConnected", "TextMessage_ClientConnected" },
+		{ "clientDisconnected", "TextMessage_ClientDisconnected" },
+		{ "clientTimeout", "TextMessage_ClientDropped" },
+		{ "channelKick", "TextMessage_ClientKicked" },
+		{ "serverKick", "TextMessage_ClientKicked" },
+		{ "clientBan", "TextMessage_ClientBanned" },
+		{ "clientMoveBySelf", "TextMessage_ClientMoved" },
+		{ "clientMoveByOther", "TextMessage_ClientMoved" },
+		{ "channelCreated", "TextMessage_ChannelCreated" },
+		{ "channelDeleted", "TextMessage_ChannelCreated" }
+	};
+	return styles.value(kind, "InfoMessage");
+}
+
+QString StatusText::userLink(const QString& link, const QString& name)
+{
+	return QString("<a href=\"%1\" class=\"TextMessage_UserLink\" oncontextmenu=\"ts3LinkClicked(event)\">\"%2\"</a>").arg(link, name.toHtmlEscaped());
+}
+
+QString StatusText::plainLink(const QString& link, const QString& name)
+{
+	return QString("<a href=\"%1\">\"%2\"</a>").arg(link, name.toHtmlEscaped());
+}
+
+QString StatusText::serverConnected(const QString& serverName)
+{
+	if (serverName.isEmpty())
+		return "Connected";
+
+	return QString("Connected to Server: <b><a href=\"channelid://0\" class=\"TextMessage_ServerLink\" oncontextmenu=\"ts3LinkClicked(event)\">%1</a></b>")
+		.arg(serverName.toHtmlEscaped());
+}
+
+QString StatusText::serverDisconnected()
+{
+	return "Disconnected";
+}
+
+QString StatusText::serverStopped(const QString& message)
+{
+	return QString("Server Shutdown: %1").arg(message.toHtmlEscaped());
+}
+
+QString StatusText::clientConnected(const QString& link, const QString& name)
+{
+	return QString("%1 connected").arg(userLink(link, name));
+}
+
+QString StatusText::clientDisconnected(const QString& link, const QString& name, const QString& message)
+{
+	return QString("%1 disconnected (%2)").arg(userLink(link, name), message.toHtmlEscaped());
+}
+
+QString StatusText::clientTimeout(const QString& link, const QString& name)
+{
+	return QString("%1 timed out").arg(userLink(link, name));
+}
+
+// channelKick, serverKick or clientBan
+QString StatusText::kicked(const QString& kind, const QString& link, const QString& name, const QString& kickerLink, const QString& kickerName, const QString& message)
+{
+	const QString what = kind == "clientBan" ? "banned from the server"
+		: kind == "serverKick" ? "kicked from the server"
+		: link.isEmpty() ? "kicked from the channel" : "kicked from a channel";
+	if (link.isEmpty())
+		return QString("You were %1 by %2 (%3)").arg(what, userLink(kickerLink, kickerName), message.toHtmlEscaped());
+
+	return QString("%1 was %2 by %3 (%4)").arg(userLink(link, name), what, userLink(kickerLink, kickerName), message.toHtmlEscaped());
+}
+
+QString StatusText::movedBySelf(const QString& link, const QString& name, const QString& oldChannelLink, const QString& oldChannelName,
+	const QString& newChannelLink, const QString& newChannelName)
+{
+	const QString channels = QString("from channel %1 to %2").arg(plainLink(oldChannelLink, oldChannelName), plainLink(newChannelLink, newChannelName));
+	if (link.isEmpty())
+		return QString("You switched %1").arg(channels);
+
+	return QString("%1 switched %2").arg(plainLink(link, name), channels);
+}
+
+QString StatusText::movedByOther(const QString& link, const QString& name, const QString& moverLink, const QString& moverName,
+	const QString& oldChannelLink, const QString& oldChannelName, const QString& newChannelLink, const QString& newChannelName, const QString& moveMessage)
+{
+	const QString rest = QString("moved from channel %1 to %2 by %3%4")
+		.arg(plainLink(oldChannelLink, oldChannelName), plainLink(newChannelLink, newChannelName), plainLink(moverLink, moverName),
+			moveMessage.isEmpty() ? QString() : QString("(%1)").arg(moveMessage.toHtmlEscaped()));
+	if (link.isEmpty())
+		return QString("You were %1").arg(rest);
+
+	return QString("%1 was %2").arg(plainLink(link, name), rest);
+}
+
+QString StatusText::channelCreated(const QString& channelLink, const QString& channelName, const QString& creatorLink, const QString& creatorName)
+{
+	if (creatorLink.isEmpty())
+		return QString("Channel %1 created successfully").arg(plainLink(channelLink, channelName));
+
+	return QString("Channel %1 created successfully by %2").arg(plainLink(channelLink, channelName), plainLink(creatorLink, creatorName));
+}
+
+QString StatusText::channelDeleted(const QString& channelLink, const QString& channelName, const QString& deleterLink, const QString& deleterName)
+{
+	if (deleterLink.isEmpty())
+		return QString("Channel %1 was deleted").arg(plainLink(channelLink, channelName));
+
+	return QString("Channel %1 was deleted by %2").arg(plainLink(channelLink, channelName), plainLink(deleterLink, deleterName));
+}
@@ -0,0 +1,40 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QJsonObject>
+#include <QString>
+
+// status lines rendered here instead of in the page, it only puts the text in statusTextTemplate,
+// names and messages are escaped, links are expected to be escaped already
+// an empty link means the line is about ourselves
+class StatusText
+{
+public:
+	// page event for a status line, kind is what happened and picks its style
+	static QJsonObject event(const QString& kind, const QString& target, const QString& text);
+
+	static QString serverConnected(const QString& serverName);
+	static QString serverDisconnected();
+	static QString serverStopped(const QString& message);
+	static QString clientConnected(const QString& link, const QString& name);
+	static QString clientDisconnected(const QString& link, const QString& name, const QString& message);
+	static QString clientTimeout(const QString& link, const QString& name);
+	static QString kicked(const QString& kind, const QString& link, const QString& name, const QString& kickerLink, const QString& kickerName, const QString& message);
+	static QString movedBySelf(const QString& link, const QString& name, const QString& oldChannelLink, const QString& oldChannelName,
+		const QString& newChannelLink, const QString& newChannelName);
+	static QString movedByOther(const QString& link, const QString& name, const QString& moverLink, const QString& moverName,
+		const QString& oldChannelLink, const QString& oldChannelName, const QString& newChannelLink, const QString& newChannelName, const QString& moveMessage);
+	static QString channelCreated(const QString& channelLink, const QString& channelName, const QString& creatorLink, const QString& creatorName);
+	static QString channelDeleted(const QString& channelLink, const QString& channelName, const QString& deleterLink, const QString& deleterName);
+
+private:
+	static QString style(const QString& kind);
+	static QString userLink(const QString& link, const QString& name);
+	static QString plainLink(const QString& link, const QString& name);
+};
@@ -6,13 +6,11 @@
 */
 
 #include "TsClient.h"
-#include "utils.h"
+#include "UidPool.h"
 
 TsClient::TsClient(const QString& name, const QString& uniqueId, unsigned short clientId) 
 	: name_(name)
-	, uniqueId_(uniqueId)
-	, safeUniqueId_(utils::ts3WeirdBase16(uniqueId))
-	, clientLink_(link(clientId, uniqueId, name))
+	, uid_(UidPool::instance().intern(uniqueId))
 	, clientId_(clientId)
 	, historyRead_(false)
 {
@@ -20,12 +18,17 @@ TsClient::TsClient(const QString& name, const QString& uniqueId, unsigned short
 
 TsClient::~TsClient()
 {
+	UidPool::instance().release(uid_);
 }
 
 void TsClient::setName(QString newName)
 {
 	name_ = newName;
-	clientLink_ = link(clientId_, uniqueId_, name_);
+}
+
+void TsClient::setClientId(unsigned short clientId)
+{
+	clientId_ = clientId;
 }
 
 QString TsClient::name() const
@@ -35,17 +38,27 @@ QString TsClient::name() const
 
 QString TsClient::uniqueId() const
 {
-	return uniqueId_;
+	return UidPool::instance().uniqueId(uid_);
 }
 
 QString TsClient::safeUniqueId() const
 {
-	return safeUniqueId_;
+	return UidPool::instance().safeUniqueId(uid_);
+}
+
+quint32 TsClient::uidHandle() const
+{
+	return uid_;
 }
 
 QString TsClient::clientLink() const
 {
-	return clientLink_;
+	return link(clientId_, uniqueId(), name_);
+}
+
+unsigned short TsClient::clientId() const
+{
+	return clientId_;
 }
 
 bool TsClient::historyRead() const
@@ -53,7 +66,7 @@ bool TsClient::historyRead() const
 	return historyRead_;
 }
 
-void TsClient::setHistoryRead()
+void TsClient::setHistoryRead(bool read)
 {
-	historyRead_ = true;
-}
\ No newline at end of file
+	historyRead_ = read;
+}
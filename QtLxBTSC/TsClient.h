@@ -9,21 +9,27 @@
 
 #include <QObject>
 
+// the unique id lives in UidPool, the link is put together when asked for
 class TsClient
 {
 
 public:
 	TsClient(const QString& name, const QString& uniqueId, unsigned short clientId);
 	~TsClient();
+	Q_DISABLE_COPY(TsClient)
 
 	QString name() const;
 	QString safeUniqueId() const;
 	QString uniqueId() const;
+	quint32 uidHandle() const;
 	QString clientLink() const;
+	unsigned short clientId() const;
 	bool historyRead() const;
-	void setHistoryRead();
+	void setHistoryRead(bool read = true);
 
 	void setName(QString newName);
+	// a client gets a new id every time it connects
+	void setClientId(unsigned short clientId);
 
 	static QString link(unsigned short clientId, const QString& uniqueId, const QString& name)
 	{
@@ -32,9 +38,7 @@ public:
 
 private:
 	QString name_;
-	const QString uniqueId_;
-	QString safeUniqueId_;
-	QString clientLink_;
-	const unsigned short clientId_;
+	const quint32 uid_;
+	unsigned short clientId_;
 	bool historyRead_;
 };
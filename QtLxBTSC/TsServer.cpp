@@ -6,13 +6,21 @@
 */
 
 #include "TsServer.h"
+#include "UidPool.h"
 #include <QString>
+#include <QElapsedTimer>
 
 TsServer::TsServer(unsigned long long serverId, const QString& uniqueId) 
 	: serverId_(serverId)
 	, uniqueId_(uniqueId)
 	, safeUniqueId_(uniqueId.toLatin1().toBase64())
 	, connected_(true)
+	, historyRead_(false)
+	, generation_(1)
+	, hits_(0)
+	, misses_(0)
+	, returned_(0)
+	, evicted_(0)
 {
 	updateClients();
 	updateOwnId();
@@ -49,9 +57,39 @@ void TsServer::setDisconnected()
 	connected_ = false;
 }
 
-void TsServer::setConnected()
+void TsServer::setConnected(unsigned long long serverId)
 {
+	serverId_ = serverId;
 	connected_ = true;
+	// ids of the previous connection are stale now, everyone counts as gone until seen again
+	for (const ClientSlot& slot : clientSlots_)
+	{
+		if (slot.generation == generation_ && slot.client != nullptr)
+		{
+			depart(slot.client);
+		}
+	}
+	++generation_;
+	rosterQueue_.clear();
+}
+
+bool TsServer::historyRead() const
+{
+	return historyRead_;
+}
+
+void TsServer::setHistoryRead(bool read)
+{
+	historyRead_ = read;
+}
+
+void TsServer::resetHistoryRead()
+{
+	historyRead_ = false;
+	for (QSharedPointer<TsClient> client : clients_)
+	{
+		client->setHistoryRead(false);
+	}
 }
 
 QSharedPointer<TsClient> TsServer::addClient(unsigned short clientId)
@@ -63,33 +101,120 @@ QSharedPointer<TsClient> TsServer::addClient(unsigned short clientId)
 
 QSharedPointer<TsClient> TsServer::addClient(unsigned short clientId, QSharedPointer<TsClient> client)
 {
-	clientIdCache_.insert(clientId, client->uniqueId());
-	if (clients_.contains(client->uniqueId()))
+	auto known = clients_.constFind(client->uidHandle());
+	if (known != clients_.constEnd())
 	{
-		auto old = clients_.value(client->uniqueId());
-		old->setName(client->name());
+		auto old = known.value();
+		if (departed_.removeOne(old->uidHandle()))
+		{
+			++returned_;
+		}
+		renameClient(old, client->name());
+		old->setClientId(clientId);
+		setSlot(clientId, old);
 		return old;
 	}
-	clients_.insert(client->uniqueId(), client);
+	clients_.insert(client->uidHandle(), client);
+	clientNames_.insert(client->name(), client);
+	setSlot(clientId, client);
 	return client;
 }
 
-QSharedPointer<TsClient> TsServer::getClient(unsigned short clientId) const
+QSharedPointer<TsClient> TsServer::getClient(unsigned short clientId)
 {
-	const QString uid = clientIdCache_.value(clientId);
-	return clients_.value(uid);
+	if (clientId >= clientSlots_.size())
+	{
+		++misses_;
+		return nullptr;
+	}
+
+	const ClientSlot& slot = clientSlots_.at(clientId);
+	if (slot.generation == generation_ && slot.client != nullptr)
+	{
+		++hits_;
+		return slot.client;
+	}
+	++misses_;
+	if (slot.generation != generation_)
+		return nullptr;
+
+	auto c = getClientInfo(clientId);
+	if (c == nullptr)
+	{
+		clientSlots_[clientId].generation = 0;
+		return nullptr;
+	}
+	return addClient(clientId, c);
 }
 
-QSharedPointer<TsClient> TsServer::getClientByName(const QString& name) const
+bool TsServer::current(unsigned short clientId) const
 {
-	for (QSharedPointer<TsClient> client : clients_)
+	return clientId < clientSlots_.size() && clientSlots_.at(clientId).generation == generation_;
+}
+
+bool TsServer::waiting(unsigned short clientId) const
+{
+	return current(clientId) && clientSlots_.at(clientId).client == nullptr;
+}
+
+void TsServer::setSlot(unsigned short clientId, const QSharedPointer<TsClient>& client)
+{
+	if (clientId >= clientSlots_.size())
+	{
+		clientSlots_.resize(clientId + 1);
+	}
+	clientSlots_[clientId] = { client, generation_ };
+}
+
+QSharedPointer<TsClient> TsServer::getClientByName(const QString& name)
+{
+	// the one we are looking for may not have been read yet, only the nicknames of
+	// waiting clients are asked for and just the ones that match are read
+	if (!clientNames_.contains(name))
 	{
-		if (client->name() == name)
+		const QByteArray wanted = name.toUtf8();
+		char res[TS3_MAX_SIZE_CLIENT_NICKNAME];
+		for (int i = rosterQueue_.size() - 1; i >= 0; --i)
 		{
-			return client;
+			const unsigned short clientId = rosterQueue_.at(i);
+			if (ts3Functions.getClientDisplayName(serverId_, clientId, res, TS3_MAX_SIZE_CLIENT_NICKNAME) == ERROR_ok && wanted == res)
+			{
+				rosterQueue_.removeAt(i);
+				getClient(clientId);
+			}
 		}
 	}
-	return QSharedPointer<TsClient>(nullptr);
+
+	// only looks at the slots, nothing is read here
+	QSharedPointer<TsClient> found;
+	for (auto it = clientNames_.constFind(name); it != clientNames_.constEnd() && it.key() == name; ++it)
+	{
+		const unsigned short clientId = it.value()->clientId();
+		if (current(clientId) && clientSlots_.at(clientId).client == it.value())
+			return it.value();
+
+		if (found == nullptr)
+		{
+			found = it.value();
+		}
+	}
+	return found;
+}
+
+QSharedPointer<TsClient> TsServer::getClientByUid(const QString& uniqueId) const
+{
+	const quint32 handle = UidPool::instance().find(uniqueId);
+	return handle != UidPool::invalid ? clients_.value(handle) : nullptr;
+}
+
+void TsServer::renameClient(const QSharedPointer<TsClient>& client, const QString& name)
+{
+	if (client->name() == name)
+		return;
+
+	clientNames_.remove(client->name(), client);
+	client->setName(name);
+	clientNames_.insert(name, client);
 }
 
 QString TsServer::getChannelName(uint64 channelID)
@@ -103,7 +228,7 @@ QString TsServer::getChannelName(uint64 channelID)
 	return name;
 }
 
-// cache all connected visible clients
+// note all connected visible clients, those already known on this connection are skipped
 void TsServer::updateClients()
 {
 	anyID* list;
@@ -111,15 +236,9 @@ void TsServer::updateClients()
 	{
 		for (size_t i = 0; list[i] != NULL; i++)
 		{
-			auto c = getClientInfo(list[i]);
-			clientIdCache_.insert(list[i], c->uniqueId());
-			if (clients_.contains(c->uniqueId()))
+			if (!current(list[i]))
 			{
-				clients_.value(c->uniqueId())->setName(c->name());
-			}
-			else
-			{
-				clients_.insert(c->uniqueId(), c);
+				clientEntered(list[i]);
 			}
 		}
 		free(list);
@@ -131,6 +250,114 @@ void TsServer::updateClients()
 	}
 }
 
+// whoever had the id before is gone
+void TsServer::clientEntered(unsigned short clientId)
+{
+	if (!waiting(clientId))
+	{
+		setSlot(clientId, nullptr);
+		rosterQueue_.append(clientId);
+	}
+}
+
+bool TsServer::syncRoster(int budget)
+{
+	QElapsedTimer timer;
+	timer.start();
+	while (!rosterQueue_.isEmpty() && (budget < 0 || timer.elapsed() < budget))
+	{
+		getClient(rosterQueue_.takeFirst());
+	}
+	evict();
+	return !rosterQueue_.isEmpty();
+}
+
+void TsServer::clientLeft(unsigned short clientId)
+{
+	if (!current(clientId))
+		return;
+
+	if (clientSlots_.at(clientId).client != nullptr)
+	{
+		depart(clientSlots_.at(clientId).client);
+	}
+	clientSlots_[clientId] = { nullptr, 0 };
+	evict();
+}
+
+void TsServer::clientHidden(unsigned short clientId)
+{
+	if (!current(clientId))
+		return;
+
+	// read it now, it can't be once it is out of view
+	if (waiting(clientId))
+	{
+		rosterQueue_.removeOne(clientId);
+	}
+	auto c = getClient(clientId);
+	if (c != nullptr)
+	{
+		depart(c);
+	}
+	evict();
+}
+
+void TsServer::depart(const QSharedPointer<TsClient>& client)
+{
+	departed_.removeOne(client->uidHandle());
+	departed_.prepend(client->uidHandle());
+}
+
+// while the roster is read everyone of the last connection is still in departed_
+void TsServer::evict()
+{
+	if (!rosterQueue_.isEmpty())
+		return;
+
+	for (int i = departed_.size() - 1; i >= 0 && departed_.size() > maxDeparted; --i)
+	{
+		const quint32 handle = departed_.at(i);
+		if (pinned_.contains(handle))
+			continue;
+
+		// out of view but still connected with its id
+		auto slotted = clients_.value(handle);
+		if (slotted != nullptr && current(slotted->clientId()) && clientSlots_.at(slotted->clientId()).client == slotted)
+			continue;
+
+		auto client = clients_.take(handle);
+		if (client != nullptr)
+		{
+			clientNames_.remove(client->name(), client);
+		}
+		departed_.removeAt(i);
+		++evicted_;
+	}
+}
+
+void TsServer::pin(quint32 uidHandle)
+{
+	pinned_.insert(uidHandle);
+}
+
+void TsServer::unpin(quint32 uidHandle)
+{
+	pinned_.remove(uidHandle);
+	evict();
+}
+
+QString TsServer::clientStats() const
+{
+	return QString("Clients on %1: %2 cached, %3 gone, %4 pinned, %5 hits, %6 misses, %7 came back, %8 dropped")
+		.arg(uniqueId_).arg(clients_.size()).arg(departed_.size()).arg(pinned_.size()).arg(hits_).arg(misses_).arg(returned_).arg(evicted_);
+}
+
+bool TsServer::rosterPending() const
+{
+	return !rosterQueue_.isEmpty();
+}
+
 // cache channel names
 void TsServer::updateChannels()
 {
@@ -179,8 +406,9 @@ QSharedPointer<TsClient> TsServer::getClientInfo(unsigned short clientId)
 	char* uid;
 	if (ts3Functions.getClientVariableAsString(serverId_, clientId, CLIENT_UNIQUE_IDENTIFIER, &uid) == ERROR_ok)
 	{
+		QSharedPointer<TsClient> client(new TsClient(res, uid, clientId));
 		free(uid);
-		return QSharedPointer<TsClient>(new TsClient(res, uid, clientId));
+		return client;
 	}
 	//ts3Functions.logMessage("Failed to get client unique id", LogLevel_ERROR, "BetterChat", 0);
 	logError("Failed to get client unique id");
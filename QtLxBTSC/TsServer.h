@@ -9,6 +9,11 @@
 
 #include <QObject>
 #include <QMap>
+#include <QHash>
+#include <QMultiHash>
+#include <QVector>
+#include <QList>
+#include <QSet>
 #include <QSharedPointer>
 #include <globals.h>
 #include "TsClient.h"
@@ -25,27 +30,74 @@ public:
 	bool connected() const;
 	unsigned short myId() const;
 	void setDisconnected();
-	void setConnected();
+	// a reconnect can come through a new server connection handler
+	void setConnected(unsigned long long serverId);
+	bool historyRead() const;
+	void setHistoryRead(bool read = true);
+	// page was reloaded, everything has to be sent again
+	void resetHistoryRead();
 	QSharedPointer<TsClient> addClient(unsigned short clientId);
 	QSharedPointer<TsClient> addClient(unsigned short clientId, QSharedPointer<TsClient> client);
-	QSharedPointer<TsClient> getClient(unsigned short clientId) const;
-	QSharedPointer<TsClient> getClientByName(const QString& name) const;
+	// clients that are only known by id are read from TeamSpeak on first use
+	QSharedPointer<TsClient> getClient(unsigned short clientId);
+	// nicknames are not unique, a client that is still connected wins
+	QSharedPointer<TsClient> getClientByName(const QString& name);
+	QSharedPointer<TsClient> getClientByUid(const QString& uniqueId) const;
+	void renameClient(const QSharedPointer<TsClient>& client, const QString& name);
 	QString getChannelName(uint64 channelID);
+	// only takes note of the ids, the clients are read by getClient or syncRoster
 	void updateClients();
+	void clientEntered(unsigned short clientId);
+	// kept for a while in case it comes back, the least recently seen are dropped
+	void clientLeft(unsigned short clientId);
+	// still connected somewhere we can't see, keeps its id so private messages still find it
+	void clientHidden(unsigned short clientId);
+	// a client with an open private tab is never dropped
+	void pin(quint32 uidHandle);
+	void unpin(quint32 uidHandle);
+	// read waiting clients for up to budget ms, -1 for all, true if some are left
+	bool syncRoster(int budget);
+	bool rosterPending() const;
 	void updateOwnId();
 	void updateChannels();
 	void updateChannel(uint64 channelID);
+	QString clientStats() const;
 
 private:
 	unsigned long long serverId_;
 	const QString uniqueId_;
 	QString safeUniqueId_;
 	bool connected_;
+	bool historyRead_;
 	unsigned short myId_;
-	QMap<unsigned short, QString> clientIdCache_;
-	QMap<QString, QSharedPointer<TsClient>> clients_;
+	// indexed by client id, ids are handed out again after a reconnect so a slot
+	// only counts if it was filled during the current connection, a current slot
+	// without client is an id that was seen but not read yet
+	struct ClientSlot
+	{
+		QSharedPointer<TsClient> client;
+		quint32 generation;
+	};
+	QVector<ClientSlot> clientSlots_;
+	quint32 generation_;
+	QList<unsigned short> rosterQueue_;
+	QHash<quint32, QSharedPointer<TsClient>> clients_;     // by UidPool handle
+	QMultiHash<QString, QSharedPointer<TsClient>> clientNames_;
+	QList<quint32> departed_;     // most recently seen first
+	QSet<quint32> pinned_;
+	quint64 hits_;
+	quint64 misses_;
+	quint64 returned_;
+	quint64 evicted_;
 	QMap<unsigned long long, QString> channelNameCache_;
 
 	QString getChannelInfo(uint64 channelID);
 	QSharedPointer<TsClient> getClientInfo(unsigned short clientId);
+	void setSlot(unsigned short clientId, const QSharedPointer<TsClient>& client);
+	bool current(unsigned short clientId) const;
+	bool waiting(unsigned short clientId) const;
+	void depart(const QSharedPointer<TsClient>& client);
+	void evict();
+
+	const static int maxDeparted = 200;
 };
@@ -6,10 +6,26 @@
 */
 
 #include "TsWebObject.h"
+#include "WireFormat.h"
+#include "globals.h"
+#include <QTimer>
 
 TsWebObject::TsWebObject(QObject *parent)
 	: QObject(parent)
+	, batchTimer(new QTimer(this))
+	, batchInterval(16)
+	, lowPower(false)
+	, ready(false)
+	, lastBatch(0)
+	, dropped(0)
+	, sentEvents(0)
+	, sentBatches(0)
+	, sentBytes(0)
 {
+	// about one frame
+	batchTimer->setSingleShot(true);
+	batchTimer->setInterval(batchInterval);
+	connect(batchTimer, &QTimer::timeout, this, &TsWebObject::flush);
 }
 
 TsWebObject::~TsWebObject()
@@ -20,3 +36,285 @@ void TsWebObject::emoteClicked(QString e)
 {
 	emit emoteSignal(e);
 }
+
+// page scrolled to the oldest loaded message of a tab
+void TsWebObject::requestHistory(QString target, int mode, QString client, double before, int count)
+{
+	emit historyPageRequested(target, mode, client, static_cast<qint64>(before), count);
+}
+
+// times are in seconds, 0 for no limit
+void TsWebObject::searchHistory(QString text, QString target, int mode, QString sender, double from, double to, int limit)
+{
+	emit historySearchRequested(text, target, mode, sender, static_cast<qint64>(from), static_cast<qint64>(to), limit);
+}
+
+void TsWebObject::pageLoaded()
+{
+	logInfo("Page ready");
+
+	// the page starts empty, tab events queued meanwhile are part of the replay already
+	QList<Event> rest;
+	for (const Event& event : pending)
+	{
+		if (!ReplayBuffer::recorded(event.message))
+		{
+			rest.append(event);
+		}
+	}
+	pending.clear();
+	held.clear();
+	// every tab is rebuilt from the replay, nothing on it is new anymore
+	if (!unread.isEmpty())
+	{
+		unread.clear();
+		emit unreadChanged();
+	}
+	for (const QJsonObject& message : replay.events(pageLines))
+	{
+		enqueue(message, 0, 0);
+	}
+	pending.append(rest);
+
+	ready = true;
+	emit pageReady();
+	flush();
+}
+
+// page is loading or reloading, nothing can be delivered until it calls pageLoaded
+void TsWebObject::pageUnloaded()
+{
+	ready = false;
+	batchTimer->stop();
+	inFlight.clear();
+}
+
+void TsWebObject::batchRendered(int batch, double handleMs, double insertMs)
+{
+	const qint64 now = LatencyStats::now();
+	const Batch sent = inFlight.take(batch);
+	if (sent.sent == 0)
+		return;
+
+	const qint64 handle = static_cast<qint64>(handleMs * 1000);
+	const qint64 insert = static_cast<qint64>(insertMs * 1000);
+	latency.record(LatencyStats::Handle, handle);
+	latency.record(LatencyStats::Insert, insert);
+	latency.record(LatencyStats::Bridge, qMax<qint64>(0, now - sent.sent - handle - insert));
+	for (qint64 started : sent.started)
+	{
+		latency.record(LatencyStats::Total, now - started);
+	}
+}
+
+void TsWebObject::tabShown(QString target, int mode, QString client)
+{
+	shownTab = ReplayBuffer::tabKey(target, mode, client);
+	auto it = held.find(shownTab);
+	if (it != held.end())
+	{
+		pending.append(it.value());
+		held.erase(it);
+	}
+	if (unread.remove(shownTab) > 0)
+	{
+		emit unreadChanged();
+	}
+	flush();
+}
+
+void TsWebObject::post(const QJsonObject& message, qint64 received)
+{
+	const qint64 now = LatencyStats::now();
+	if (received > 0)
+	{
+		latency.record(LatencyStats::Handler, now - received);
+	}
+	enqueue(replay.record(message), received, now);
+	if (ready && !pending.isEmpty() && !batchTimer->isActive())
+	{
+		batchTimer->start();
+	}
+}
+
+// events for tabs the page doesn't show are held, rendering them and fetching their embeds
+// is wasted until the tab is opened
+void TsWebObject::enqueue(const QJsonObject& message, qint64 received, qint64 posted)
+{
+	const QString tab = ReplayBuffer::tabKey(message);
+	// history logs are sent right away, they are not lines of a tab and held ones were evicted by them
+	const QString type = message.value("type").toString();
+	const bool history = type == "chatLog" || type == "privateChatLog";
+	if (tab.isEmpty() || tab == shownTab || history)
+	{
+		// oldest go first if the page never comes back
+		if (pending.size() >= maxPending)
+		{
+			pending.removeFirst();
+			++dropped;
+		}
+		pending.append({ message, received, posted });
+		return;
+	}
+
+	// older ones can be asked for from the replay, time spent held is not measured
+	QList<Event>& queue = held[tab];
+	if (queue.size() >= pageLines)
+	{
+		queue.removeFirst();
+	}
+	queue.append({ message, 0, 0 });
+	if (posted > 0 && type == "textMessage")
+	{
+		++unread[tab];
+		emit unreadChanged();
+	}
+}
+
+void TsWebObject::requestRange(QString target, int mode, QString client, int before, int count)
+{
+	QJsonArray events;
+	for (const QJsonObject& message : replay.range(ReplayBuffer::tabKey(target, mode, client), before, count))
+	{
+		events.append(message);
+	}
+	QJsonObject json
+	{
+		{"type", "tabRange"},
+		{"target", target},
+		{"mode", mode},
+		{"client", client},
+		{"before", before},
+		{"events", events}
+	};
+	pending.append({ json, 0, LatencyStats::now() });
+	flush();
+}
+
+int TsWebObject::unreadCount(const QString& target, int mode, const QString& client) const
+{
+	return unread.value(ReplayBuffer::tabKey(target, mode, client));
+}
+
+void TsWebObject::clearReplay()
+{
+	replay.clear();
+}
+
+void TsWebObject::setBatchInterval(int msec)
+{
+	batchInterval = msec;
+	if (!lowPower)
+	{
+		batchTimer->setInterval(batchInterval);
+	}
+}
+
+void TsWebObject::setLowPower(bool low)
+{
+	if (low == lowPower)
+		return;
+
+	lowPower = low;
+	batchTimer->setInterval(lowPower ? qMax(batchInterval, lowPowerInterval) : batchInterval);
+	emit powerModeChanged(lowPower);
+	// catch up right away
+	if (!lowPower)
+	{
+		batchTimer->stop();
+		flush();
+	}
+}
+
+bool TsWebObject::isLowPower() const
+{
+	return lowPower;
+}
+
+void TsWebObject::setReplayLines(int lines)
+{
+	replay.setCapacity(lines);
+}
+
+void TsWebObject::flush()
+{
+	if (!ready || pending.isEmpty())
+		return;
+
+	if (dropped > 0)
+	{
+		logInfo(QString("TsWebObject: page was not ready, dropped %1 messages").arg(dropped));
+		dropped = 0;
+	}
+
+	// a backlog goes out in several batches so the page can render in between
+	const qint64 now = LatencyStats::now();
+	Batch sent{ now, QVector<qint64>() };
+	QJsonArray batch;
+	while (!pending.isEmpty() && batch.size() < maxBatch)
+	{
+		const Event event = pending.takeFirst();
+		batch.append(event.message);
+		if (event.posted > 0)
+		{
+			latency.record(LatencyStats::Queue, now - event.posted);
+			sent.started.append(event.received > 0 ? event.received : event.posted);
+		}
+	}
+
+	// acks for batches the page never got would pile up
+	if (inFlight.size() >= maxInFlight)
+	{
+		inFlight.clear();
+	}
+	const int id = ++lastBatch;
+	inFlight.insert(id, sent);
+
+	const QByteArray packed = WireFormat::encode(batch);
+	sentEvents += batch.size();
+	++sentBatches;
+	sentBytes += packed.size();
+	emit sendMessages(id, QString::fromUtf8(packed));
+
+	if (!pending.isEmpty())
+	{
+		QTimer::singleShot(0, this, &TsWebObject::flush);
+	}
+}
+
+QJsonObject TsWebObject::wireSchema() const
+{
+	return WireFormat::schema();
+}
+
+int TsWebObject::renderWindow() const
+{
+	return pageLines;
+}
+
+QString TsWebObject::wireStats() const
+{
+	return QString("Bridge: %1 events in %2 batches, %3 bytes, %4 bytes per event")
+		.arg(sentEvents).arg(sentBatches).arg(sentBytes).arg(sentEvents > 0 ? sentBytes / sentEvents : 0);
+}
+
+QString TsWebObject::wireComparison() const
+{
+	// what the page would be sent on a reload is a fair sample of real traffic
+	QJsonArray sample;
+	for (const QJsonObject& message : replay.events(pageLines))
+	{
+		sample.append(message);
+	}
+	return WireFormat::compare(sample);
+}
+
+QString TsWebObject::replayStats() const
+{
+	return replay.stats();
+}
+
+QStringList TsWebObject::latencyStats() const
+{
+	return latency.report();
+}
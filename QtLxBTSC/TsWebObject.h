@@ -7,25 +7,116 @@
 
 #pragma once
 
+#include "LatencyStats.h"
+#include "ReplayBuffer.h"
 #include <QObject>
 #include <QJsonObject>
+#include <QJsonArray>
+#include <QList>
+#include <QHash>
+#include <QVector>
+
+class QTimer;
 
 class TsWebObject : public QObject
 {
 	Q_OBJECT
+	Q_PROPERTY(QJsonObject wireSchema READ wireSchema CONSTANT)
+	Q_PROPERTY(int renderWindow READ renderWindow CONSTANT)
+	Q_PROPERTY(bool lowPower READ isLowPower NOTIFY powerModeChanged)
 
 public:
 	TsWebObject(QObject *parent);
 	~TsWebObject();
 	Q_INVOKABLE void emoteClicked(QString e);
+	Q_INVOKABLE void requestHistory(QString target, int mode, QString client, double before, int count);
+	Q_INVOKABLE void searchHistory(QString text, QString target, int mode, QString sender, double from, double to, int limit);
+	// page has connected to the channel and loaded its config
+	Q_INVOKABLE void pageLoaded();
+	// page is done with a batch, times are what it spent on it in milliseconds
+	Q_INVOKABLE void batchRendered(int batch, double handleMs, double insertMs);
+	// events held for the tab are sent now
+	Q_INVOKABLE void tabShown(QString target, int mode, QString client);
+	// events the page dropped from a tab, answered with a tabRange
+	Q_INVOKABLE void requestRange(QString target, int mode, QString client, int before, int count);
+
+	// messages posted within one interval reach the page as a single array,
+	// until the page is ready they are kept in a bounded queue,
+	// received is when the TeamSpeak callback started if known
+	void post(const QJsonObject& message, qint64 received = 0);
+	void setBatchInterval(int msec);
+	// while TeamSpeak is in the background events are sent less often and the page saves work
+	void setLowPower(bool low);
+	bool isLowPower() const;
+	void setReplayLines(int lines);
+	void pageUnloaded();
+	// next page load starts empty
+	void clearReplay();
+	QJsonObject wireSchema() const;
+	// events per tab the page keeps rendered, older ones are asked for by scrolling
+	int renderWindow() const;
+	QString wireStats() const;
+	QString wireComparison() const;
+	QString replayStats() const;
+	QStringList latencyStats() const;
+	// text messages waiting in a tab the page doesn't show
+	int unreadCount(const QString& target, int mode, const QString& client) const;
 	
 signals:
 	void addServer(QString key);
 	void tabChanged(QString key, int mode, QString client);
 	void toggleEmoteMenu();
 	void emoteSignal(QString e);
+	void historyPageRequested(QString target, int mode, QString client, qint64 before, int count);
+	void historySearchRequested(QString text, QString target, int mode, QString sender, qint64 from, qint64 to, int limit);
 	void loadEmotes();
 	void configChanged();
+	void pageReady();
+	void unreadChanged();
+	void powerModeChanged(bool lowPower);
+
+	// batch in the positional format of WireFormat
+	void sendMessages(int batch, QString packed);
+
+private slots:
+	void flush();
+
+private:
+	void enqueue(const QJsonObject& message, qint64 received, qint64 posted);
+
+	const static int maxPending = 10000;
+	const static int pageLines = 150;
+	const static int lowPowerInterval = 1000;
+	const static int maxBatch = 500;
+
+	// times from LatencyStats::now(), 0 for replayed events which are not measured
+	struct Event
+	{
+		QJsonObject message;
+		qint64 received;
+		qint64 posted;
+	};
+	struct Batch
+	{
+		qint64 sent;
+		QVector<qint64> started;
+	};
+	const static int maxInFlight = 64;
 
-	void sendMessage(QJsonObject json);
+	QList<Event> pending;
+	QHash<QString, QList<Event>> held;
+	QHash<QString, int> unread;
+	QString shownTab;
+	ReplayBuffer replay;
+	LatencyStats latency;
+	QHash<int, Batch> inFlight;
+	QTimer* batchTimer;
+	int batchInterval;
+	bool lowPower;
+	bool ready;
+	int lastBatch;
+	int dropped;
+	quint64 sentEvents;
+	quint64 sentBatches;
+	quint64 sentBytes;
 };
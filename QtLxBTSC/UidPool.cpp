@@ -0,0 +1,76 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "UidPool.h"
+#include "utils.h"
+
+UidPool::UidPool()
+{
+}
+
+UidPool& UidPool::instance()
+{
+	static UidPool pool;
+	return pool;
+}
+
+quint32 UidPool::intern(const QString& uniqueId)
+{
+	auto it = handles.constFind(uniqueId);
+	if (it != handles.constEnd())
+	{
+		++entries[static_cast<int>(it.value())].refs;
+		return it.value();
+	}
+
+	const Entry entry{ uniqueId, utils::ts3WeirdBase16(uniqueId), 1 };
+	quint32 handle;
+	if (!freeHandles.isEmpty())
+	{
+		handle = freeHandles.takeLast();
+		entries[static_cast<int>(handle)] = entry;
+	}
+	else
+	{
+		handle = static_cast<quint32>(entries.size());
+		entries.append(entry);
+	}
+	handles.insert(uniqueId, handle);
+	return handle;
+}
+
+void UidPool::release(quint32 handle)
+{
+	Entry& entry = entries[static_cast<int>(handle)];
+	if (--entry.refs > 0)
+		return;
+
+	handles.remove(entry.uniqueId);
+	entry = Entry{ QString(), QString(), 0 };
+	freeHandles.append(handle);
+}
+
+quint32 UidPool::find(const QString& uniqueId) const
+{
+	auto it = handles.constFind(uniqueId);
+	return it != handles.constEnd() ? it.value() : invalid;
+}
+
+const QString& UidPool::uniqueId(quint32 handle) const
+{
+	return entries.at(static_cast<int>(handle)).uniqueId;
+}
+
+const QString& UidPool::safeUniqueId(quint32 handle) const
+{
+	return entries.at(static_cast<int>(handle)).safeUniqueId;
+}
+
+int UidPool::size() const
+{
+	return handles.size();
+}
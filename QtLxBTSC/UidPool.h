@@ -0,0 +1,44 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QHash>
+#include <QString>
+#include <QVector>
+
+// every unique id in use on any server is kept once together with its base16 form,
+// clients refer to it by handle, only used on the gui thread
+class UidPool
+{
+public:
+	static UidPool& instance();
+
+	// counted, every intern needs a release
+	quint32 intern(const QString& uniqueId);
+	void release(quint32 handle);
+	// invalid if the id was never interned
+	quint32 find(const QString& uniqueId) const;
+	const QString& uniqueId(quint32 handle) const;
+	const QString& safeUniqueId(quint32 handle) const;
+	int size() const;
+
+	const static quint32 invalid = 0xffffffff;
+
+private:
+	UidPool();
+
+	struct Entry
+	{
+		QString uniqueId;
+		QString safeUniqueId;
+		int refs;
+	};
+	QVector<Entry> entries;
+	QVector<quint32> freeHandles;
+	QHash<QString, quint32> handles;
+};
@@ -0,0 +1,208 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "WireFormat.h"
+#include "globals.h"
+#include <QElapsedTimer>
+#include <QJsonDocument>
+#include <QSet>
+
+// tags are the position in this list plus one, new types go to the end
+const QVector<WireFormat::Type>& WireFormat::types()
+{
+	static const QVector<Type> list = parse(
+	{
+		{ "textMessage", { "target", "direction", "time", "name", "userlink", "line", "mode", "client", "receiver", "seq" } },
+		{ "pokeMessage", { "target", "time", "link", "name", "message", "seq" } },
+		{ "welcomeMessage", { "target", "time", "message", "seq" } },
+		{ "consoleMessage", { "target", "mode", "client", "message", "seq" } },
+		{ "chatLog", { "target", "log:historyLog" } },
+		{ "privateChatLog", { "target", "client", "log:historyMessage[]" } },
+		{ "historyPage", { "target", "mode", "client", "log:historyMessage[]" } },
+		{ "searchResults", { "query", "results:searchResult[]", "complete" } },
+		{ "statusSummary", { "target", "time", "kind", "events:event[]", "seq" } },
+		{ "tabRange", { "target", "mode", "client", "before", "events:event[]" } },
+		{ "status", { "target", "time", "style", "text", "seq" } },
+		{ "consoleMessageToCurrentTab", { "message" } }
+	});
+	return list;
+}
+
+// objects inside events, a field missing from one is sent as null and left out by the page
+const QVector<WireFormat::Type>& WireFormat::records()
+{
+	static const QVector<Type> list = parse(
+	{
+		{ "historyMessage", { "time", "uid", "name", "link", "text", "line", "offset" } },
+		{ "historyLog", { "server:historyMessage[]", "channel:historyMessage[]" } },
+		{ "searchResult", { "time", "uid", "name", "link", "text", "line", "offset", "target", "mode", "client", "before" } }
+	});
+	return list;
+}
+
+QVector<WireFormat::Type> WireFormat::parse(const QVector<QPair<QString, QStringList>>& list)
+{
+	QVector<Type> parsed;
+	for (const auto& entry : list)
+	{
+		Type type{ entry.first, entry.second, {} };
+		for (const QString& spec : entry.second)
+		{
+			const QString kind = spec.section(':', 1);
+			const bool isList = kind.endsWith("[]");
+			type.layout.append({ spec.section(':', 0, 0), isList ? kind.left(kind.size() - 2) : kind, isList });
+		}
+		parsed.append(type);
+	}
+	return parsed;
+}
+
+const QHash<QString, int>& WireFormat::tags()
+{
+	static const QHash<QString, int> map = []()
+	{
+		QHash<QString, int> m;
+		for (int i = 0; i < types().size(); ++i)
+		{
+			m.insert(types().at(i).name, i + 1);
+		}
+		return m;
+	}();
+	return map;
+}
+
+const WireFormat::Type* WireFormat::record(const QString& name)
+{
+	for (const Type& type : records())
+	{
+		if (type.name == name)
+			return &type;
+	}
+	return nullptr;
+}
+
+QJsonObject WireFormat::schema()
+{
+	QJsonArray typeList;
+	for (const Type& type : types())
+	{
+		typeList.append(QJsonObject
+		{
+			{ "type", type.name },
+			{ "fields", QJsonArray::fromStringList(type.fields) }
+		});
+	}
+	QJsonArray recordList;
+	for (const Type& type : records())
+	{
+		recordList.append(QJsonObject
+		{
+			{ "record", type.name },
+			{ "fields", QJsonArray::fromStringList(type.fields) }
+		});
+	}
+	return QJsonObject
+	{
+		{ "types", typeList },
+		{ "records", recordList }
+	};
+}
+
+QByteArray WireFormat::encode(const QJsonArray& messages)
+{
+	QJsonArray packed;
+	for (const QJsonValue& value : messages)
+	{
+		packed.append(encodeEvent(value.toObject()));
+	}
+	return QJsonDocument(packed).toJson(QJsonDocument::Compact);
+}
+
+QJsonValue WireFormat::encodeEvent(const QJsonObject& message)
+{
+	const QString type = message.value("type").toString();
+	const int tag = tags().value(type, rawTag);
+	if (tag == rawTag)
+	{
+		// every type the plugin posts belongs in types(), said once per type so the log stays readable
+		static QSet<QString> reported;
+		if (!reported.contains(type))
+		{
+			reported.insert(type);
+			logInfo(QString("WireFormat: no schema for %1, sent as is").arg(type));
+		}
+		return QJsonArray{ rawTag, message };
+	}
+
+	QJsonArray fields = encodeFields(message, types().at(tag - 1).layout);
+	fields.prepend(tag);
+	return fields;
+}
+
+QJsonArray WireFormat::encodeFields(const QJsonObject& object, const QVector<Field>& layout)
+{
+	QJsonArray fields;
+	for (const Field& field : layout)
+	{
+		fields.append(encodeValue(object.value(field.name), field));
+	}
+	return fields;
+}
+
+QJsonValue WireFormat::encodeValue(const QJsonValue& value, const Field& field)
+{
+	if (field.record.isEmpty() || value.isUndefined() || value.isNull())
+		return value.isUndefined() ? QJsonValue() : value;
+
+	const Type* layout = field.record == "event" ? nullptr : record(field.record);
+	auto one = [layout](const QJsonValue& item) -> QJsonValue
+	{
+		return layout != nullptr ? QJsonValue(encodeFields(item.toObject(), layout->layout)) : encodeEvent(item.toObject());
+	};
+	if (!field.list)
+		return one(value);
+
+	QJsonArray items;
+	for (const QJsonValue& item : value.toArray())
+	{
+		items.append(one(item));
+	}
+	return items;
+}
+
+QString WireFormat::compare(const QJsonArray& messages)
+{
+	if (messages.isEmpty())
+	{
+		return QString("Wire format: nothing to compare");
+	}
+
+	// same events through both paths, repeated so short samples still give a usable time
+	const int rounds = 20;
+	int objectBytes = 0;
+	int packedBytes = 0;
+	QElapsedTimer timer;
+	timer.start();
+	for (int i = 0; i < rounds; ++i)
+	{
+		objectBytes = QJsonDocument(messages).toJson(QJsonDocument::Compact).size();
+	}
+	const qint64 objectNs = timer.nsecsElapsed();
+
+	timer.restart();
+	for (int i = 0; i < rounds; ++i)
+	{
+		packedBytes = encode(messages).size();
+	}
+	const qint64 packedNs = timer.nsecsElapsed();
+
+	const double events = static_cast<double>(messages.size()) * rounds;
+	return QString("Wire format, %1 events: objects %2 bytes per event (%3 events/s), positional %4 bytes per event (%5 events/s)")
+		.arg(messages.size())
+		.arg(objectBytes / messages.size()).arg(objectNs > 0 ? events / (objectNs / 1e9) : 0.0, 0, 'f', 0)
+		.arg(packedBytes / messages.size()).arg(packedNs > 0 ? events / (packedNs / 1e9) : 0.0, 0, 'f', 0);
+}
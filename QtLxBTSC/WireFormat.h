@@ -0,0 +1,58 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#pragma once
+
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QHash>
+#include <QPair>
+#include <QStringList>
+#include <QVector>
+
+// positional encoding of page events, [tag, field, field, ...] with the field order from a schema,
+// the page builds its decoders from schema() so both sides always agree
+//
+// a field can be "name:record" for an object laid out by a record of the schema, "name:record[]"
+// for an array of them and "event" as record for events that are themselves encoded with their tag
+class WireFormat
+{
+public:
+	// { types: [{ type, fields }], records: [{ record, fields }] }
+	static QJsonObject schema();
+	// one utf-8 buffer for a whole batch
+	static QByteArray encode(const QJsonArray& messages);
+	// bytes per event and events per second of encode against sending the objects as they are
+	static QString compare(const QJsonArray& messages);
+
+private:
+	struct Field
+	{
+		QString name;
+		QString record;   // empty for a value sent as is
+		bool list;
+	};
+
+	struct Type
+	{
+		QString name;
+		QStringList fields;
+		QVector<Field> layout;
+	};
+
+	// tag 0 carries an object as is, for types missing from the schema
+	const static int rawTag = 0;
+
+	static const QVector<Type>& types();
+	static const QVector<Type>& records();
+	static const QHash<QString, int>& tags();
+	static const Type* record(const QString& name);
+	static QVector<Type> parse(const QVector<QPair<QString, QStringList>>& list);
+	static QJsonValue encodeEvent(const QJsonObject& message);
+	static QJsonArray encodeFields(const QJsonObject& object, const QVector<Field>& layout);
+	static QJsonValue encodeValue(const QJsonValue& value, const Field& field);
+};
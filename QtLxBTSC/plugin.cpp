@@ -12,6 +12,7 @@
 
 #include "plugin.h"
 #include "PluginHelper.h"
+#include "LatencyStats.h"
 
 #define PLUGIN_API_VERSION 23
 //#define PATH_BUFSIZE 512
@@ -107,10 +108,22 @@ int ts3plugin_processCommand(uint64 serverConnectionHandlerID, const char* comma
 	{
 		helper->reload();
 	}
+	if (strcmp(command, "clear") == 0)
+	{
+		helper->clearChat();
+	}
 	if (strcmp(command, "emotes") == 0)
 	{
 		helper->fullReloadEmotes();
 	}
+	if (strcmp(command, "stats") == 0)
+	{
+		helper->printStats();
+	}
+	if (strcmp(command, "bench") == 0)
+	{
+		helper->runBenchmark();
+	}
 	return 0;  /* Plugin handled command */
 }
 
@@ -158,6 +171,7 @@ void ts3plugin_onClientMoveEvent(uint64 serverConnectionHandlerID, anyID clientI
 	if (newChannelID == 0)
 	{
 		helper->clientDisconnected(serverConnectionHandlerID, clientID, moveMessage);
+		helper->clientLeftView(serverConnectionHandlerID, clientID);
 		return;
 	}
 	if (visibility == ENTER_VISIBILITY)
@@ -165,12 +179,17 @@ void ts3plugin_onClientMoveEvent(uint64 serverConnectionHandlerID, anyID clientI
 		helper->clientEnteredView(serverConnectionHandlerID, clientID);
 	}
 	helper->clientMoveBySelf(serverConnectionHandlerID, clientID, oldChannelID, newChannelID);
+	if (visibility == LEAVE_VISIBILITY)
+	{
+		helper->clientHiddenFromView(serverConnectionHandlerID, clientID);
+	}
 
 }
 
 // client drops connection
 void ts3plugin_onClientMoveTimeoutEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, const char* timeoutMessage) {
 	helper->clientTimeout(serverConnectionHandlerID, clientID);
+	helper->clientLeftView(serverConnectionHandlerID, clientID);
 }
 
 int ts3plugin_onServerErrorEvent(uint64 serverConnectionHandlerID, const char* errorMessage, unsigned int error, const char* returnCode, const char* extraMessage) {
@@ -232,6 +251,7 @@ int ts3plugin_onServerPermissionErrorEvent(uint64 serverConnectionHandlerID, con
 
 // Client received a text message
 int ts3plugin_onTextMessageEvent(uint64 serverConnectionHandlerID, anyID targetMode, anyID toID, anyID fromID, const char* fromName, const char* fromUniqueIdentifier, const char* message, int ffIgnored) {
+	const qint64 received = LatencyStats::now();
 
 	/* Friend/Foe manager has ignored the message, so ignore here as well. */
 	if(ffIgnored) {
@@ -245,7 +265,7 @@ int ts3plugin_onTextMessageEvent(uint64 serverConnectionHandlerID, anyID targetM
 		return 0;
 	}
 
-	helper->textMessageReceived(serverConnectionHandlerID, fromID, toID, targetMode, fromUniqueIdentifier, fromName, message, myID == fromID);
+	helper->textMessageReceived(serverConnectionHandlerID, fromID, toID, targetMode, fromUniqueIdentifier, fromName, message, myID == fromID, received);
     return 0;  /* 0 = handle normally, 1 = client will ignore the text message */
 }
 
@@ -313,6 +333,10 @@ void ts3plugin_onClientMoveSubscriptionEvent(uint64 serverConnectionHandlerID, a
 	{
 		helper->clientEnteredView(serverConnectionHandlerID, clientID);
 	}
+	else if (visibility == LEAVE_VISIBILITY)
+	{
+		helper->clientHiddenFromView(serverConnectionHandlerID, clientID);
+	}
 }
 
 void ts3plugin_onClientMoveMovedEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID moverID, const char* moverName, const char* moverUniqueIdentifier, const char* moveMessage) {
@@ -321,14 +345,26 @@ void ts3plugin_onClientMoveMovedEvent(uint64 serverConnectionHandlerID, anyID cl
 		helper->clientEnteredView(serverConnectionHandlerID, clientID);
 	}
 	helper->clientMovedByOther(serverConnectionHandlerID, clientID, oldChannelID, newChannelID, moverID, moverName, moverUniqueIdentifier, moveMessage);
+	if (visibility == LEAVE_VISIBILITY)
+	{
+		helper->clientHiddenFromView(serverConnectionHandlerID, clientID);
+	}
 }
 
 void ts3plugin_onClientKickFromChannelEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage) {
 	helper->clientKickedFromChannel(serverConnectionHandlerID, clientID, kickerID, kickerName, kickerUniqueIdentifier, kickMessage);
+	if (visibility == LEAVE_VISIBILITY)
+	{
+		helper->clientHiddenFromView(serverConnectionHandlerID, clientID);
+	}
 }
 
 void ts3plugin_onClientKickFromServerEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, const char* kickMessage) {
 	helper->clientKickedFromServer(serverConnectionHandlerID, clientID, kickerID, kickerName, kickerUniqueIdentifier, kickMessage);
+	if (visibility == LEAVE_VISIBILITY)
+	{
+		helper->clientLeftView(serverConnectionHandlerID, clientID);
+	}
 }
 
 //void ts3plugin_onClientIDsEvent(uint64 serverConnectionHandlerID, const char* uniqueClientIdentifier, anyID clientID, const char* clientName) {
@@ -401,6 +437,7 @@ void ts3plugin_onClientKickFromServerEvent(uint64 serverConnectionHandlerID, any
 
 void ts3plugin_onClientBanFromServerEvent(uint64 serverConnectionHandlerID, anyID clientID, uint64 oldChannelID, uint64 newChannelID, int visibility, anyID kickerID, const char* kickerName, const char* kickerUniqueIdentifier, uint64 time, const char* kickMessage) {
 	helper->clientBannedFromServer(serverConnectionHandlerID, clientID, kickerID, kickerName, kickerUniqueIdentifier, kickMessage);
+	helper->clientLeftView(serverConnectionHandlerID, clientID);
 }
 
 //void ts3plugin_onClientSelfVariableUpdateEvent(uint64 serverConnectionHandlerID, int flag, const char* oldValue, const char* newValue) {
@@ -94,4 +94,22 @@ namespace utils
 		}
 		return ret;
 	}
-}
+
+	// unique id back from the avatar filename form
+	QString fromTs3WeirdBase16(const QString& id)
+	{
+		static const char hexArray[] = "0123456789abcdef";
+		QByteArray hex;
+		hex.reserve(id.size());
+		for (QChar c : id)
+		{
+			const int i = c.unicode() - 'a';
+			if (i < 0 || i > 15)
+			{
+				return QString();
+			}
+			hex.append(hexArray[i]);
+		}
+		return QByteArray::fromHex(hex).toBase64();
+	}
+}
\ No newline at end of file
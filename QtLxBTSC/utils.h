@@ -17,4 +17,5 @@ namespace utils
 	QString time();
 	void makeEmoteJsonArray(const QString& path);
 	QString ts3WeirdBase16(const QString& id);
+	QString fromTs3WeirdBase16(const QString& id);
 }
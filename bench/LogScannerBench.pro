@@ -0,0 +1,15 @@
+# LogScanner against the regular expression it replaced on a made up log,
+# qmake bench/LogScannerBench.pro && make, then LogScannerBench [MiB] [text %]
+
+TEMPLATE = app
+TARGET = LogScannerBench
+INCLUDEPATH += . ../QtLxBTSC
+CONFIG += release console c++11
+CONFIG -= app_bundle
+QT = core
+DESTDIR = build
+OBJECTS_DIR = obj
+
+HEADERS += ../QtLxBTSC/LogScanner.h
+SOURCES += ../QtLxBTSC/LogScanner.cpp \
+           main.cpp
@@ -0,0 +1,29 @@
+/*
+ * Better Chat plugin for TeamSpeak 3
+ * GPLv3 license
+ *
+ * Copyright (C) 2019 Luch (https://github.com/Luch00)
+*/
+
+#include "LogScanner.h"
+#include <QCoreApplication>
+#include <QStringList>
+#include <cstdio>
+
+// same run as "/lxb bench" does on its synthetic log, without TeamSpeak
+int main(int argc, char* argv[])
+{
+	QCoreApplication app(argc, argv);
+	const QStringList args = app.arguments();
+	const int mib = args.size() > 1 ? args.at(1).toInt() : 8;
+	const int textPercent = args.size() > 2 ? args.at(2).toInt() : 80;
+	if (mib <= 0 || mib > 1024 || textPercent < 0 || textPercent > 100)
+	{
+		fprintf(stderr, "usage: LogScannerBench [MiB 1-1024] [text messages 0-100 %%]\n");
+		return 1;
+	}
+
+	const QByteArray log = LogScanner::synthesize(mib * 1024 * 1024, textPercent);
+	printf("%s\n", qPrintable(LogScanner::benchmark(log.constData(), log.constData() + log.size())));
+	return 0;
+}